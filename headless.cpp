@@ -0,0 +1,1062 @@
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <array>
+#include <algorithm>
+#include <thread>
+#include <limits>
+#include <sys/wait.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+#include "src/Simulation.h"
+#include "src/FrameExporter.h"
+#include "src/FrameReader.h"
+#include "src/Validator.h"
+#include "src/FrameGovernor.h"
+#include "src/SoftwareRenderer.h"
+#include "src/VideoWriter.h"
+#include "src/ParticlePacking.h"
+#include "src/DensityField.h"
+#include "src/Tracer.h"
+
+// Headless driver: runs the simulation without a window for benchmarks and
+// batch jobs. Usage: hydration-headless <command> [options]
+
+static const float FRAME_DT = 1.0f / 60.0f;
+
+// A softer fluid that settles into a resting pool; with the default k and μ
+// the whole tank keeps splashing
+static const float CALM_GAS_CONSTANT = 200.0f;
+static const float CALM_VISCOSITY = 25.0f;
+
+// Sweep a repelling cursor back and forth so the scene has both a fast,
+// splashing region and a resting pool
+static void driveCursor(Simulation& sim, int frame) {
+    float x = 0.5f + 0.35f * std::sin(static_cast<float>(frame) * 0.04f);
+    sim.applyCursorForce(x, 0.25f, false);
+}
+
+struct RunStats {
+    double wallSeconds = 0.0;
+    double simSeconds = 0.0;
+    long long particleUpdates = 0;
+};
+
+static RunStats runFrames(Simulation& sim, int frames, int firstFrame) {
+    RunStats stats;
+    long long updatesBefore = sim.getParticleUpdateCount();
+    auto start = std::chrono::steady_clock::now();
+
+    for (int f = 0; f < frames; f++) {
+        driveCursor(sim, firstFrame + f);
+        sim.update(FRAME_DT);
+    }
+
+    auto end = std::chrono::steady_clock::now();
+    stats.wallSeconds = std::chrono::duration<double>(end - start).count();
+    stats.simSeconds = static_cast<double>(frames) * FRAME_DT;
+    stats.particleUpdates = sim.getParticleUpdateCount() - updatesBefore;
+    return stats;
+}
+
+static void printStats(const std::string& label, const RunStats& s) {
+    std::cout << "  " << std::left << std::setw(10) << label << std::right
+              << std::setw(14) << std::fixed << std::setprecision(0)
+              << s.particleUpdates / s.simSeconds << " updates/sim-s"
+              << std::setw(10) << std::setprecision(3)
+              << s.wallSeconds / s.simSeconds << " wall-s/sim-s" << std::endl;
+}
+
+// Compare uniform sub-stepping with multi-rate local time stepping, on the
+// default fluid (stiff: its CFL limit sits near the uniform sub-step) and on
+// the calm fluid, whose resting pool can take coarser steps
+static int benchLocalTimeStepping(int numParticles, int frames) {
+    const int warmupFrames = 120;
+
+    std::cout << "[Hydration] Local time stepping: " << numParticles
+              << " particles, " << frames << " frames" << std::endl;
+
+    for (bool calm : { false, true }) {
+        Simulation uniform(numParticles);
+        Simulation multiRate(numParticles);
+        multiRate.setLocalTimeStepping(true);
+        if (calm) {
+            for (Simulation* sim : { &uniform, &multiRate }) {
+                sim->setGasConstant(CALM_GAS_CONSTANT);
+                sim->setViscosity(CALM_VISCOSITY);
+            }
+        }
+
+        // Let both settle into a pool before measuring
+        runFrames(uniform, warmupFrames, 0);
+        runFrames(multiRate, warmupFrames, 0);
+
+        RunStats u = runFrames(uniform, frames, warmupFrames);
+        RunStats m = runFrames(multiRate, frames, warmupFrames);
+
+        std::cout << (calm ? " calm fluid" : " default fluid") << std::endl;
+        printStats("uniform", u);
+        printStats("multirate", m);
+        std::cout << "  speedup   " << std::fixed << std::setprecision(2) << u.wallSeconds / m.wallSeconds
+                  << "x wall, " << 100.0 * static_cast<double>(m.particleUpdates) / u.particleUpdates
+                  << "% of the uniform updates" << std::endl;
+
+        const auto& histogram = multiRate.getTimeBinHistogram();
+        std::cout << "  time bins (bin 0 = uniform sub-step):";
+        for (int b = 0; b <= Simulation::MAX_TIME_BIN; b++) {
+            std::cout << " " << histogram[b];
+        }
+        std::cout << ", " << multiRate.getWakeCount() << " neighbors woken" << std::endl;
+    }
+    return 0;
+}
+
+// Largest time-bin gap between neighbors (within h) once a multi-rate
+// tick's active set is final, overall and where the coarser particle sits
+// the tick out
+class BinSpreadObserver : public PhaseObserver {
+public:
+    int maxGap = 0;
+    int maxInactiveGap = 0;
+
+    void afterPhase(SimPhase phase, const Simulation& sim) override {
+        if (phase != SimPhase::Neighbors) return;
+        const ParticleArray& particles = sim.getParticles();
+        size_t n = particles.size();
+        active.assign(n, 0);
+        for (int i : sim.getActiveParticles()) active[i] = 1;
+
+        float h2 = sim.getSmoothingRadius() * sim.getSmoothingRadius();
+        for (size_t i = 0; i < n; i++) {
+            for (size_t j = i + 1; j < n; j++) {
+                glm::vec2 diff = particles[i].position - particles[j].position;
+                if (glm::dot(diff, diff) >= h2) continue;
+                size_t coarse = particles[i].timeBin > particles[j].timeBin ? i : j;
+                int gap = std::abs(particles[i].timeBin - particles[j].timeBin);
+                maxGap = std::max(maxGap, gap);
+                if (!active[coarse]) maxInactiveGap = std::max(maxInactiveGap, gap);
+            }
+        }
+    }
+
+private:
+    std::vector<uint8_t> active;
+};
+
+// Throughput and memory placement with and without NUMA-aware execution
+static int benchNuma(int numParticles, int frames, int threads) {
+    const int warmupFrames = 30;
+
+    std::cout << "[Hydration] NUMA: " << numParticles << " particles, " << frames
+              << " frames" << std::endl;
+
+    const struct { const char* label; bool numaAware; bool hugePages; } modes[] = {
+        { "off",       false, false },
+        { "numa",      true,  false },
+        { "numa+thp",  true,  true  },
+    };
+
+    for (const auto& mode : modes) {
+        Simulation sim(numParticles);
+        sim.setExecution(threads, mode.numaAware, mode.hugePages);
+        sim.setNeighborListInterval(1);
+        runFrames(sim, warmupFrames, 0);
+
+        RunStats stats = runFrames(sim, frames, warmupFrames);
+        NumaStats numa = sim.getNumaStats();
+
+        std::cout << "  " << std::left << std::setw(10) << mode.label << std::right
+                  << std::fixed << std::setprecision(0) << std::setw(12)
+                  << stats.particleUpdates / stats.wallSeconds << " updates/s"
+                  << std::setprecision(3)
+                  << "  remote pages " << numa.remotePageFraction
+                  << "  remote neighbor reads " << numa.remoteNeighborFraction
+                  << "  (" << numa.threads << " threads, " << numa.nodes << " nodes"
+                  << (numa.pinned ? ", pinned" : "") << ")" << std::endl;
+    }
+    return 0;
+}
+
+// Reader side of bench-export: runs in a forked process and consumes frames
+// in place until the writer has published `frames` of them
+static void readExportedFrames(const std::string& name, uint64_t frames) {
+    FrameReader reader;
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (!reader.open(name)) {
+        if (std::chrono::steady_clock::now() > deadline) {
+            std::cerr << "ERROR::EXPORT: reader could not open " << name << std::endl;
+            return;
+        }
+        std::this_thread::yield();
+    }
+
+    std::vector<double> latencies;
+    uint64_t lastFrame = 0, torn = 0, bytesRead = 0;
+    double checksum = 0.0;
+    auto start = std::chrono::steady_clock::now();
+
+    while (reader.getPublishedFrames() < frames) {
+        FrameView view;
+        if (!reader.acquireLatest(view) || view.frameIndex == lastFrame) {
+            std::this_thread::yield();
+            continue;
+        }
+
+        uint64_t now = exportClockNanos();
+        // Consume the arrays directly from shared memory
+        double sum = 0.0;
+        for (uint32_t i = 0; i < view.count; i++) {
+            sum += view.positions[i * 2] + view.velocities[i * 2] + view.densities[i];
+        }
+        if (!reader.validate(view)) {
+            torn++;
+            continue;
+        }
+
+        checksum += sum;
+        lastFrame = view.frameIndex;
+        bytesRead += static_cast<uint64_t>(view.count) * 5 * sizeof(float);
+        latencies.push_back(static_cast<double>(now - view.publishNanos) * 1e-3);
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::sort(latencies.begin(), latencies.end());
+    double mean = 0.0;
+    for (double l : latencies) mean += l;
+    mean /= std::max<size_t>(1, latencies.size());
+
+    std::cout << "  reader    " << latencies.size() << "/" << frames << " frames, "
+              << torn << " torn reads retried" << std::endl;
+    if (!latencies.empty()) {
+        std::cout << "  latency   mean " << std::fixed << std::setprecision(1) << mean
+                  << " us, p99 " << latencies[latencies.size() * 99 / 100]
+                  << " us, max " << latencies.back() << " us" << std::endl;
+    }
+    std::cout << "  read bw   " << std::setprecision(1) << bytesRead / seconds / 1e6
+              << " MB/s (checksum " << std::setprecision(0) << checksum << ")" << std::endl;
+}
+
+// Publishes live frames to a forked reader process, then measures raw
+// publish throughput
+static int benchExport(int numParticles, int frames) {
+    std::string name = std::string(DEFAULT_EXPORT_NAME) + "-bench";
+    Simulation sim(numParticles);
+    FrameExporter exporter;
+    if (!exporter.open(name, numParticles)) return 1;
+
+    std::cout << "[Hydration] Frame export: " << numParticles << " particles, "
+              << frames << " frames" << std::endl;
+    std::cout.flush();
+
+    pid_t child = fork();
+    if (child == 0) {
+        readExportedFrames(name, static_cast<uint64_t>(frames));
+        std::cout.flush();
+        _exit(0);
+    }
+
+    double publishSeconds = 0.0;
+    for (int f = 0; f < frames; f++) {
+        driveCursor(sim, f);
+        sim.update(FRAME_DT);
+
+        auto start = std::chrono::steady_clock::now();
+        exporter.publish(sim);
+        publishSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+    waitpid(child, nullptr, 0);
+
+    std::cout << "  publish   " << std::fixed << std::setprecision(1)
+              << publishSeconds / frames * 1e6 << " us/frame alongside the simulation" << std::endl;
+
+    // Back-to-back publishing with no reader attached
+    const int burst = 500;
+    auto start = std::chrono::steady_clock::now();
+    for (int f = 0; f < burst; f++) {
+        exporter.publish(sim);
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    double bytes = static_cast<double>(burst) * numParticles * 5 * sizeof(float);
+    std::cout << "  burst     " << std::setprecision(0) << burst / seconds << " frames/s, "
+              << std::setprecision(2) << bytes / seconds / 1e9 << " GB/s" << std::endl;
+    return 0;
+}
+
+// Checks every production execution path against the brute-force reference
+// and fails (exit code 1) when a relative max deviation exceeds the tolerance
+static int validate(int numParticles, int frames, double tolerance) {
+    const int warmupFrames = 60;
+    const int wavefrontBandBytes = 4 * 1024;   // Several bands at validation sizes
+
+    std::cout << "[Hydration] Validation: " << numParticles << " particles, " << frames
+              << " frames, tolerance " << std::scientific << std::setprecision(1)
+              << tolerance << std::endl;
+
+    enum { FIXED, ADAPTIVE_H, ADAPTIVE_RESOLUTION, OPEN_FLOOR, LOCAL_TIME_STEPPING, WAVEFRONT };
+    const struct { const char* label; int threads; int listInterval; bool numaAware; int mode; } configs[] = {
+        { "grid, 1 thread",      1, 0, false, FIXED },
+        { "lists, 1 thread",     1, 1, false, FIXED },
+        { "grid, all threads",   0, 0, false, FIXED },
+        { "lists, all threads",  0, 1, false, FIXED },
+        { "numa sort, lists",    0, 1, true,  FIXED },
+        { "adaptive h, grid",    0, 0, false, ADAPTIVE_H },
+        { "adaptive h, lists",   0, 1, false, ADAPTIVE_H },
+        { "adaptive resolution", 0, 0, false, ADAPTIVE_RESOLUTION },
+        { "open floor, lists",   0, 1, false, OPEN_FLOOR },
+        { "local time stepping", 0, 0, false, LOCAL_TIME_STEPPING },
+        { "lts, 4 threads",      4, 0, false, LOCAL_TIME_STEPPING },
+        { "wavefront, grid",     0, 0, false, WAVEFRONT },
+        { "wavefront, lists",    0, 1, false, WAVEFRONT },
+    };
+
+    bool passed = true;
+    for (const auto& config : configs) {
+        Simulation sim(numParticles);
+        sim.setExecution(config.threads, config.numaAware);
+        sim.setNeighborListInterval(config.listInterval);
+        sim.setAdaptiveSmoothing(config.mode == ADAPTIVE_H || config.mode == ADAPTIVE_RESOLUTION);
+        sim.setAdaptiveResolution(config.mode == ADAPTIVE_RESOLUTION);
+        sim.setLocalTimeStepping(config.mode == LOCAL_TIME_STEPPING);
+        sim.setWavefront(config.mode == WAVEFRONT);
+        sim.setWavefrontBandBytes(wavefrontBandBytes);
+        if (config.mode == OPEN_FLOOR) {
+            // No side walls: the splash spreads into negative cells and blocks
+            float inf = std::numeric_limits<float>::infinity();
+            sim.setDomain(glm::vec2(-inf, 0.0f), glm::vec2(inf));
+        }
+        if (config.mode == ADAPTIVE_RESOLUTION || config.mode == LOCAL_TIME_STEPPING) {
+            // Calm enough to pool, so particles actually merge or coarsen
+            sim.setGasConstant(CALM_GAS_CONSTANT);
+            sim.setViscosity(CALM_VISCOSITY);
+        }
+
+        // Validate a splashing scene rather than the initial lattice
+        runFrames(sim, warmupFrames, 0);
+
+        Validator validator(FRAME_DT);
+        sim.setPhaseObserver(&validator);
+        runFrames(sim, frames, warmupFrames);
+        sim.setPhaseObserver(nullptr);
+
+        std::cout << "  " << config.label << " (" << sim.getThreadCount() << " threads";
+        std::cout << ")" << std::endl;
+        if (config.mode == WAVEFRONT) {
+            // Falling back to phase at a time would pass the checks above
+            bool ran = sim.getWavefrontBandCount() > 0;
+            passed = passed && ran;
+            std::cout << "    wavefront      " << sim.getWavefrontBandCount() << " bands"
+                      << (ran ? "" : "  FAIL") << std::endl;
+        }
+        for (int c = 0; c < CHECK_COUNT; c++) {
+            const Deviation& d = validator.getDeviation(static_cast<ValidationCheck>(c));
+            if (d.samples == 0) continue;
+
+            bool ok = d.relativeMax() <= tolerance;
+            passed = passed && ok;
+            std::cout << "    " << std::left << std::setw(14) << validationCheckName(static_cast<ValidationCheck>(c))
+                      << std::right << std::scientific << std::setprecision(3)
+                      << " max " << d.maxAbs << "  rel max " << d.relativeMax()
+                      << "  rel rms " << d.relativeRms() << (ok ? "" : "  FAIL") << std::endl;
+        }
+    }
+
+    // A jet driven into a resting multi-rate pool: every calm particle it
+    // reaches must be woken, so no particle is stepped while a neighbor more
+    // than one bin coarser sits the tick out
+    {
+        // Soft enough that the resting pool reaches the coarsest bin
+        Simulation sim(numParticles);
+        sim.setGasConstant(0.25f * CALM_GAS_CONSTANT);
+        sim.setViscosity(CALM_VISCOSITY);
+        sim.setLocalTimeStepping(true);
+        runFrames(sim, 4 * warmupFrames, 0);
+        std::array<int, Simulation::MAX_TIME_BIN + 1> restingBins = sim.getTimeBinHistogram();
+
+        glm::vec2 lo, hi;
+        sim.getFluidBounds(lo, hi);
+        BinSpreadObserver spread;
+        sim.setPhaseObserver(&spread);
+        long long wokenBefore = sim.getWakeCount();
+        for (int f = 0; f < 10; f++) {
+            sim.addForce(0.5f * (lo.x + hi.x), hi.y + 0.05f, 0.15f, 0.5f);
+            sim.update(FRAME_DT);
+        }
+        sim.setPhaseObserver(nullptr);
+
+        bool ok = spread.maxInactiveGap <= 1;
+        passed = passed && ok;
+        std::cout << "  jet into a resting pool (bins at rest";
+        for (int count : restingBins) std::cout << " " << count;
+        std::cout << "): max neighbor bin gap " << spread.maxGap << ", " << spread.maxInactiveGap
+                  << " to an idle neighbor, " << sim.getWakeCount() - wokenBefore << " woken"
+                  << (ok ? "" : "  FAIL") << std::endl;
+    }
+
+    // The wavefront reorders work, not arithmetic: at any thread count, and
+    // under the app's frame governor (which always caches neighbor lists),
+    // it must reproduce the sorted phase-at-a-time state bit for bit
+    {
+        const struct { int threads; bool governed; } runs[] = {
+            { 0, false }, { 1, false }, { 4, false }, { 7, false }, { 1, true },
+        };
+        std::vector<Particle> sortedState;
+        for (const auto& run : runs) {
+            Simulation sim(numParticles);
+            sim.setExecution(std::max(run.threads, 1), run.threads == 0);
+            sim.setWavefront(run.threads > 0);
+            sim.setWavefrontBandBytes(wavefrontBandBytes);
+            if (run.governed) FrameGovernor().apply(sim);
+            runFrames(sim, warmupFrames + frames, 0);
+
+            const ParticleArray& particles = sim.getParticles();
+            if (run.threads == 0) {
+                sortedState.assign(particles.begin(), particles.end());
+                continue;
+            }
+            bool ok = sim.getWavefrontBandCount() > 0 &&
+                std::equal(particles.begin(), particles.end(), sortedState.begin(), sortedState.end(),
+                    [](const Particle& a, const Particle& b) {
+                        return std::memcmp(&a, &b, sizeof(Particle)) == 0;
+                    });
+            passed = passed && ok;
+            std::cout << "  wavefront matches sorted phase-at-a-time bit for bit ("
+                      << run.threads << " threads, " << (run.governed ? "governor's lists, " : "")
+                      << sim.getWavefrontBandCount() << " bands)" << (ok ? "" : "  FAIL") << std::endl;
+        }
+    }
+
+    // A surface field reused while the particle count shrinks (as under
+    // adaptive resolution) must match a fresh one: workers left without
+    // particles may not keep the larger run's splats
+    {
+        Simulation large(numParticles);
+        Simulation small(9);
+        DensityField reused(4);
+        DensityField fresh(4);
+        reused.update(large);
+        reused.update(small);
+        fresh.update(small);
+        bool ok = reused.getValues() == fresh.getValues() &&
+                  reused.getSegments().size() == fresh.getSegments().size();
+        passed = passed && ok;
+        std::cout << "  surface field reused across a shrinking count ("
+                  << reused.getSegments().size() << " vs " << fresh.getSegments().size()
+                  << " segments)" << (ok ? "" : "  FAIL") << std::endl;
+    }
+
+    std::cout << (passed ? "  PASS" : "  FAIL") << std::endl;
+    return passed ? 0 : 1;
+}
+
+// Simulates and renders frames with the CPU renderer into a video stream
+static int renderVideo(int numParticles, int frames, const std::string& output,
+                       int width, int height, bool drawSurface) {
+    // Keep stdout clean when the video itself goes there
+    std::ostream& log = output == "-" ? std::cerr : std::cout;
+
+    Simulation sim(numParticles);
+    SoftwareRenderer renderer;
+    DensityField surface;
+    if (drawSurface) renderer.setSurface(&surface);
+    VideoWriter writer;
+    if (!writer.open(output, width, height, static_cast<int>(std::lround(1.0f / FRAME_DT)))) {
+        return 1;
+    }
+
+    double simSeconds = 0.0, renderSeconds = 0.0, writeSeconds = 0.0;
+    for (int f = 0; f < frames; f++) {
+        auto t0 = std::chrono::steady_clock::now();
+        driveCursor(sim, f);
+        sim.update(FRAME_DT);
+        if (drawSurface) surface.update(sim);
+        auto t1 = std::chrono::steady_clock::now();
+        renderer.render(sim, width, height);
+        auto t2 = std::chrono::steady_clock::now();
+        if (!writer.writeFrame(renderer.getPixels().data())) {
+            std::cerr << "ERROR::VIDEO: Write failed at frame " << f << std::endl;
+            return 1;
+        }
+        auto t3 = std::chrono::steady_clock::now();
+
+        simSeconds += std::chrono::duration<double>(t1 - t0).count();
+        renderSeconds += std::chrono::duration<double>(t2 - t1).count();
+        writeSeconds += std::chrono::duration<double>(t3 - t2).count();
+    }
+    writer.close();
+
+    double videoSeconds = static_cast<double>(frames) * FRAME_DT;
+    log << "[Hydration] Rendered " << frames << " frames of " << numParticles << " particles at "
+        << width << "x" << height << " to " << output << std::endl;
+    log << std::fixed << std::setprecision(2)
+        << "  simulate  " << simSeconds * 1000.0 / frames << " ms/frame" << std::endl
+        << "  render    " << renderSeconds * 1000.0 / frames << " ms/frame ("
+        << videoSeconds / renderSeconds << "x real time, " << renderer.getPixels().size() / 3
+        << " px)" << std::endl
+        << "  write     " << writeSeconds * 1000.0 / frames << " ms/frame" << std::endl;
+    return 0;
+}
+
+// CPU side of the particle upload: the float repack of the old path vs.
+// packing straight into the streamed 12-byte layout, plus the error the
+// quantization introduces
+static int benchUpload(int numParticles, int frames) {
+    // Stepping a million particles takes minutes; a radial kick gives the
+    // resting layout a realistic velocity range instead
+    Simulation sim(numParticles);
+    sim.addForce(0.5f, 0.7f, 0.5f, 3.0f);
+    const auto& particles = sim.getParticles();
+    size_t n = particles.size();
+
+    std::vector<float> floats(n * 6);
+    std::vector<PackedParticle> packed(n);
+    // Normalized over the view bounds, as Renderer does
+    glm::vec2 domainMin, domainMax;
+    sim.getViewBounds(domainMin, domainMax);
+    glm::vec2 domainSize = domainMax - domainMin;
+
+    auto start = std::chrono::steady_clock::now();
+    for (int f = 0; f < frames; f++) {
+        for (size_t i = 0; i < n; i++) {
+            floats[i * 6 + 0] = particles[i].position.x;
+            floats[i * 6 + 1] = particles[i].position.y;
+            floats[i * 6 + 2] = particles[i].velocity.x;
+            floats[i * 6 + 3] = particles[i].velocity.y;
+            floats[i * 6 + 4] = particles[i].density;
+            floats[i * 6 + 5] = std::sqrt(particles[i].mass / sim.getParticleMass());
+        }
+    }
+    auto mid = std::chrono::steady_clock::now();
+    for (int f = 0; f < frames; f++) {
+        packParticles(particles, 1, domainMin, domainSize, sim.getParticleMass(), packed.data(),
+                      static_cast<int>(n));
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    double positionError = 0.0, velocityError = 0.0, densityError = 0.0;
+    for (size_t i = 0; i < n; i++) {
+        const Particle& p = particles[i];
+        const PackedParticle& q = packed[i];
+        for (int c = 0; c < 2; c++) {
+            double decoded = domainMin[c] + q.position[c] / 65535.0 * domainSize[c];
+            positionError = std::max(positionError, std::abs(decoded - p.position[c]));
+            velocityError = std::max(velocityError,
+                                     static_cast<double>(std::abs(halfToFloat(q.velocity[c]) - p.velocity[c])));
+        }
+        densityError = std::max(densityError,
+                                static_cast<double>(std::abs(halfToFloat(q.density) - p.density) / p.density));
+    }
+
+    double floatMs = std::chrono::duration<double>(mid - start).count() * 1000.0 / frames;
+    double packedMs = std::chrono::duration<double>(end - mid).count() * 1000.0 / frames;
+    std::cout << "[Hydration] Upload: " << numParticles << " particles, " << frames << " frames" << std::endl;
+    std::cout << std::fixed << std::setprecision(2)
+              << "  float     " << floatMs << " ms/frame  " << n * 6 * sizeof(float) / 1e6
+              << " MB/frame (+ glBufferData copy)" << std::endl
+              << "  packed    " << packedMs << " ms/frame  " << n * sizeof(PackedParticle) / 1e6
+              << " MB/frame (written in place)" << std::endl
+              << std::scientific << std::setprecision(2)
+              << "  max error position " << positionError << ", velocity " << velocityError
+              << ", density " << densityError << " (relative)" << std::endl;
+    return 0;
+}
+
+// Percentiles of a sample, for distribution summaries
+static void printDistribution(const std::string& label, std::vector<double> values) {
+    if (values.empty()) return;
+    std::sort(values.begin(), values.end());
+    auto at = [&](double q) { return values[static_cast<size_t>(q * (values.size() - 1))]; };
+    std::cout << "    " << std::left << std::setw(12) << label << std::right << std::fixed
+              << std::setprecision(2) << " min " << at(0.0) << "  p10 " << at(0.1)
+              << "  median " << at(0.5) << "  p90 " << at(0.9) << "  max " << at(1.0) << std::endl;
+}
+
+// Fixed vs. adaptive smoothing length: cost per sub-step and how evenly
+// neighbors are spread between the bulk and the spray
+static int benchAdaptive(int numParticles, int frames) {
+    const int warmupFrames = 120;
+    const int sampleInterval = 10;
+    const int starvedNeighbors = 6;
+
+    std::cout << "[Hydration] Adaptive smoothing: " << numParticles << " particles, "
+              << frames << " frames" << std::endl;
+
+    for (bool adaptive : { false, true }) {
+        Simulation sim(numParticles);
+        sim.setAdaptiveSmoothing(adaptive);
+        runFrames(sim, warmupFrames, 0);
+
+        std::vector<double> neighbors, lengths;
+        double wallSeconds = 0.0;
+        for (int f = 0; f < frames; f += sampleInterval) {
+            int chunk = std::min(sampleInterval, frames - f);
+            wallSeconds += runFrames(sim, chunk, warmupFrames + f).wallSeconds;
+
+            std::vector<int> counts = sim.getNeighborCounts();
+            const auto& particles = sim.getParticles();
+            for (size_t i = 0; i < counts.size(); i++) {
+                neighbors.push_back(counts[i]);
+                lengths.push_back(particles[i].smoothingLength / sim.getSmoothingRadius());
+            }
+        }
+
+        double starved = 0.0;
+        for (double count : neighbors) {
+            if (count < starvedNeighbors) starved++;
+        }
+        double steps = static_cast<double>(frames) * sim.getSubsteps();
+
+        std::cout << "  " << (adaptive ? "adaptive h" : "fixed h") << std::fixed << std::setprecision(3)
+                  << "  " << wallSeconds * 1000.0 / steps << " ms/sub-step  "
+                  << std::setprecision(1) << 100.0 * starved / neighbors.size()
+                  << "% with < " << starvedNeighbors << " neighbors" << std::endl;
+        printDistribution("neighbors", neighbors);
+        if (adaptive) printDistribution("h / h0", lengths);
+    }
+    return 0;
+}
+
+// Adaptive smoothing alone vs. adaptive resolution on a pool that is only
+// stirred on its left side: particle count over time, cost per frame, and
+// whether the free surface keeps full resolution
+static int benchResolution(int numParticles, int frames) {
+    const int sampleInterval = 60;
+
+    std::cout << "[Hydration] Adaptive resolution: " << numParticles << " particles, "
+              << frames << " frames" << std::endl;
+
+    double baseMs = 0.0;
+    for (bool resolution : { false, true }) {
+        Simulation sim(numParticles);
+        sim.setGasConstant(CALM_GAS_CONSTANT);
+        sim.setViscosity(CALM_VISCOSITY);
+        sim.setAdaptiveSmoothing(true);
+        sim.setAdaptiveResolution(resolution);
+
+        std::cout << "  " << (resolution ? "adaptive resolution" : "adaptive h only") << std::endl;
+        double wallSeconds = 0.0, sampleSeconds = 0.0;
+        long long particleFrames = 0;
+        int merges = 0, splits = 0;
+        for (int f = 0; f < frames; f++) {
+            float x = 0.2f + 0.1f * std::sin(static_cast<float>(f) * 0.04f);
+            sim.applyCursorForce(x, 0.25f, false);
+            auto start = std::chrono::steady_clock::now();
+            sim.update(FRAME_DT);
+            sampleSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            particleFrames += sim.getParticleCount();
+            merges += sim.getResolutionStats().merges;
+            splits += sim.getResolutionStats().splits;
+
+            if ((f + 1) % sampleInterval != 0 && f + 1 != frames) continue;
+
+            // Surface particles (below rest density) that kept the base mass
+            int surface = 0, surfaceBase = 0;
+            std::array<int, Simulation::MAX_MASS_LEVEL + 1> levels{};
+            for (const auto& p : sim.getParticles()) {
+                int level = static_cast<int>(std::lround(std::log2(p.mass / sim.getParticleMass())));
+                levels[std::clamp(level, 0, Simulation::MAX_MASS_LEVEL)]++;
+                if (p.density < sim.getRestDensity()) {
+                    surface++;
+                    if (level == 0) surfaceBase++;
+                }
+            }
+            int chunk = (f % sampleInterval) + 1;
+            std::cout << "    frame " << std::setw(5) << f + 1 << std::setw(7) << sim.getParticleCount()
+                      << " particles (levels";
+            for (int count : levels) std::cout << " " << count;
+            std::cout << ")  " << std::fixed << std::setprecision(2)
+                      << sampleSeconds * 1000.0 / chunk << " ms/frame  surface at base mass "
+                      << std::setprecision(1) << (surface ? 100.0 * surfaceBase / surface : 100.0)
+                      << "%" << std::endl;
+            wallSeconds += sampleSeconds;
+            sampleSeconds = 0.0;
+        }
+
+        double ms = wallSeconds * 1000.0 / frames;
+        std::cout << std::fixed << std::setprecision(2) << "    mean " << ms << " ms/frame, "
+                  << std::setprecision(0) << static_cast<double>(particleFrames) / frames << " particles";
+        if (resolution) {
+            const ResolutionStats& stats = sim.getResolutionStats();
+            std::cout << ", " << merges << " merges, " << splits << " splits, speedup "
+                      << std::setprecision(2) << baseMs / ms << "x" << std::endl
+                      << std::scientific << std::setprecision(2) << "    max relative error mass "
+                      << stats.maxMassError << ", momentum " << stats.maxMomentumError;
+        }
+        std::cout << std::endl;
+        baseMs = ms;
+    }
+    return 0;
+}
+
+// Density splat + surface extraction next to the simulation step it runs
+// after. h shrinks with the particle spacing so large runs keep the usual
+// neighbor count.
+static int benchSurface(int numParticles, int frames) {
+    std::cout << "[Hydration] Free surface: " << numParticles << " particles, " << frames
+              << " frames" << std::endl;
+
+    Simulation sim(numParticles);
+    sim.setSmoothingRadius(0.04f * std::sqrt(2000.0f / static_cast<float>(numParticles)));
+    DensityField field;
+    DensityField serialField(1);
+
+    double simSeconds = 0.0, fieldSeconds = 0.0, firstFieldSeconds = 0.0;
+    bool identical = true;
+    for (int f = 0; f < frames; f++) {
+        auto t0 = std::chrono::steady_clock::now();
+        driveCursor(sim, f);
+        sim.update(FRAME_DT);
+        auto t1 = std::chrono::steady_clock::now();
+        field.update(sim);
+        auto t2 = std::chrono::steady_clock::now();
+
+        simSeconds += std::chrono::duration<double>(t1 - t0).count();
+        double seconds = std::chrono::duration<double>(t2 - t1).count();
+        if (f == 0) firstFieldSeconds = seconds;
+        else fieldSeconds += seconds;
+
+        // Tiles never share nodes, so the thread count cannot change a bit
+        serialField.update(sim);
+        identical = identical && serialField.getValues() == field.getValues();
+    }
+
+    double simMs = simSeconds * 1000.0 / frames;
+    double fieldMs = frames > 1 ? fieldSeconds * 1000.0 / (frames - 1) : firstFieldSeconds * 1000.0;
+    std::cout << "  grid " << field.getWidth() << "x" << field.getHeight() << " nodes, "
+              << field.getActiveTileCount() << "/" << field.getTileCount() << " tiles active, "
+              << field.getSegments().size() << " surface segments (" << field.getThreadCount()
+              << " threads)" << std::endl
+              << std::fixed << std::setprecision(2)
+              << "  simulate  " << simMs << " ms/frame" << std::endl
+              << "  surface   " << fieldMs << " ms/frame (" << firstFieldSeconds * 1000.0
+              << " ms first), " << std::setprecision(1) << 100.0 * fieldMs / simMs
+              << "% of the step" << std::endl
+              << "  serial and parallel fields " << (identical ? "identical" : "DIFFER") << std::endl;
+    return identical ? 0 : 1;
+}
+
+// A dam break of the calm fluid in the unit box, a long channel, a large box
+// and on an open floor: grid blocks, the surface field and their memory
+// follow the area the fluid covers, while a dense grid would follow the domain
+static int benchDomain(int numParticles, int frames) {
+    const int samples = 4;
+    float inf = std::numeric_limits<float>::infinity();
+    struct Domain {
+        const char* name;
+        glm::vec2 min, max;
+    };
+    const Domain domains[] = {
+        { "box 1x1", glm::vec2(0.0f), glm::vec2(1.0f) },
+        { "channel 16x1", glm::vec2(0.0f), glm::vec2(16.0f, 1.0f) },
+        { "box 64x64", glm::vec2(-32.0f, 0.0f), glm::vec2(32.0f, 64.0f) },
+        { "open floor", glm::vec2(-inf, 0.0f), glm::vec2(inf) },
+    };
+
+    std::cout << "[Hydration] Sparse domain: " << numParticles << " particles, " << frames
+              << " frames" << std::endl;
+
+    for (const Domain& domain : domains) {
+        Simulation sim(numParticles);
+        sim.setGasConstant(CALM_GAS_CONSTANT);
+        sim.setViscosity(CALM_VISCOSITY);
+        sim.setDomain(domain.min, domain.max);
+        DensityField surface;
+        float h = sim.getSmoothingRadius();
+        float blockSide = h * SparseGrid::BLOCK_SIZE;
+
+        std::cout << "  " << domain.name << std::endl;
+        double wallSeconds = 0.0;
+        int done = 0;
+        for (int s = 1; s <= samples; s++) {
+            int chunk = frames * s / samples - done;
+            auto start = std::chrono::steady_clock::now();
+            for (int f = 0; f < chunk; f++) {
+                sim.update(FRAME_DT);
+            }
+            wallSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            done += chunk;
+
+            glm::vec2 lo, hi;
+            sim.getFluidBounds(lo, hi);
+            GridStats grid = sim.getGridStats();
+            surface.update(sim);
+            std::cout << "    frame " << std::setw(5) << done << std::fixed << std::setprecision(2)
+                      << "  fluid " << hi.x - lo.x << " x " << hi.y - lo.y
+                      << std::setprecision(1) << "  " << std::setw(4) << grid.blocks << " blocks ("
+                      << grid.blocks * blockSide * blockSide << " area, " << grid.pooledBlocks
+                      << " pooled)  " << grid.liveBytes / 1024.0 << " / " << grid.bytes / 1024.0
+                      << " KB live / pooled  surface "
+                      << surface.getWidth() << "x" << surface.getHeight() << " nodes, "
+                      << surface.getValues().size() * sizeof(float) / 1024.0 << " KB" << std::endl;
+        }
+
+        glm::vec2 size = domain.max - domain.min;
+        std::cout << "    " << std::fixed << std::setprecision(2) << wallSeconds * 1000.0 / frames
+                  << " ms/frame; dense grid over the domain: ";
+        if (std::isfinite(size.x) && std::isfinite(size.y)) {
+            double cells = std::ceil(size.x / h) * std::ceil(size.y / h);
+            std::cout << std::setprecision(1) << cells * sizeof(int) / 1024.0 << " KB of cell offsets" << std::endl;
+        } else {
+            std::cout << "unbounded" << std::endl;
+        }
+    }
+    return 0;
+}
+
+// Last-level cache misses of the calling thread from the hardware counters;
+// unavailable where the kernel or the virtual machine exposes no PMU
+class CacheMissCounter {
+public:
+    CacheMissCounter() {
+#ifdef __linux__
+        perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = PERF_COUNT_HW_CACHE_MISSES;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        fd = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+#endif
+    }
+    ~CacheMissCounter() {
+        if (fd >= 0) close(fd);
+    }
+    CacheMissCounter(const CacheMissCounter&) = delete;
+    CacheMissCounter& operator=(const CacheMissCounter&) = delete;
+
+    bool isAvailable() const { return fd >= 0; }
+    long long read() const {
+        long long count = 0;
+        if (fd < 0 || ::read(fd, &count, sizeof(count)) != static_cast<ssize_t>(sizeof(count))) return 0;
+        return count;
+    }
+
+private:
+    int fd = -1;
+};
+
+// Phase-at-a-time against wavefront sub-steps on one thread, so the counter
+// sees every access. The sorted phase-at-a-time run shares the wavefront's
+// particle order and has to end bit for bit identical to it. h shrinks with
+// the particle spacing, as in bench-surface.
+static int benchWavefront(int numParticles, int frames) {
+    std::cout << "[Hydration] Wavefront: " << numParticles << " particles, " << frames
+              << " frames (1 thread)" << std::endl;
+
+    const struct { const char* label; bool sorted; bool wavefront; } schedules[] = {
+        { "phase at a time", false, false },
+        { "phase, sorted",   true,  false },
+        { "wavefront",       false, true  },
+    };
+
+    // Streamed bytes per sub-step once the arrays outgrow the last-level
+    // cache: every pass over the particles reads them and writes back the
+    // ones it changed. Phase at a time makes seven passes (grid, density,
+    // forces, XSPH, XSPH apply, integrate, boundary) of which five write;
+    // the wavefront reads them for the grid and the bands, then once more
+    // with a single write-back, while XSPH corrections stay in the window.
+    double particleBytes = static_cast<double>(numParticles) * sizeof(Particle);
+    double indexBytes = static_cast<double>(numParticles) * sizeof(int);
+    double correctionBytes = static_cast<double>(numParticles) * sizeof(glm::vec2);
+    const double modelBytes[] = {
+        12.0 * particleBytes + 2.0 * correctionBytes,
+        12.0 * particleBytes + 2.0 * correctionBytes,
+        4.0 * particleBytes + 2.0 * indexBytes,
+    };
+
+    CacheMissCounter counter;
+    std::vector<Particle> sortedState;
+    bool identical = true;
+    for (int k = 0; k < 3; k++) {
+        Simulation sim(numParticles);
+        sim.setExecution(1, schedules[k].sorted);
+        sim.setSmoothingRadius(0.04f * std::sqrt(2000.0f / static_cast<float>(numParticles)));
+        sim.setWavefront(schedules[k].wavefront);
+
+        long long missesBefore = counter.read();
+        RunStats stats = runFrames(sim, frames, 0);
+        long long misses = counter.read() - missesBefore;
+        int substeps = frames * sim.getSubsteps();
+
+        std::cout << "  " << std::left << std::setw(16) << schedules[k].label << std::right
+                  << std::fixed << std::setprecision(1) << std::setw(9)
+                  << stats.wallSeconds * 1000.0 / substeps << " ms/sub-step  DRAM ";
+        if (counter.isAvailable()) {
+            std::cout << std::setw(7) << static_cast<double>(misses) * 64.0 / substeps / (1 << 20)
+                      << " MB/sub-step measured, ";
+        }
+        std::cout << std::setw(7) << modelBytes[k] / (1 << 20) << " MB/sub-step modeled";
+        if (schedules[k].wavefront) {
+            std::cout << ", " << sim.getWavefrontBandCount() << " bands";
+        }
+        std::cout << std::endl;
+
+        const ParticleArray& particles = sim.getParticles();
+        if (schedules[k].sorted) {
+            sortedState.assign(particles.begin(), particles.end());
+        } else if (schedules[k].wavefront) {
+            identical = std::equal(particles.begin(), particles.end(), sortedState.begin(),
+                [](const Particle& a, const Particle& b) {
+                    return std::memcmp(&a, &b, sizeof(Particle)) == 0;
+                });
+        }
+    }
+
+    if (!counter.isAvailable()) {
+        std::cout << "  (no hardware cache counters; DRAM traffic is the streaming model)" << std::endl;
+    }
+    std::cout << "  wavefront and sorted phase-at-a-time states "
+              << (identical ? "identical" : "DIFFER") << std::endl;
+    return identical ? 0 : 1;
+}
+
+// Simulate, surface and CPU-render frames once untraced and once traced into
+// a Chrome trace-event file, to show what recording costs
+static int traceFrames(int numParticles, int frames, const std::string& output) {
+    std::cout << "[Hydration] Trace: " << numParticles << " particles, " << frames
+              << " frames, 640x360" << std::endl;
+    trace::setThreadName("main");
+
+    // A Scope in isolation, off and recording (that session is discarded)
+    const int probeScopes = 1000000;
+    auto probe = [&] {
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < probeScopes; i++) {
+            trace::Scope scope("probe", "probe", i);
+        }
+        return std::chrono::duration<double, std::nano>(
+            std::chrono::steady_clock::now() - start).count() / probeScopes;
+    };
+    double offNanos = probe();
+    trace::start();
+    double onNanos = probe();
+    trace::stop("");
+
+    auto run = [&](bool traced) {
+        Simulation sim(numParticles);
+        DensityField surface;
+        SoftwareRenderer renderer;
+        renderer.setSurface(&surface);
+        if (traced) trace::start();
+        auto start = std::chrono::steady_clock::now();
+        for (int f = 0; f < frames; f++) {
+            trace::Scope frameScope("frame", "main", f);
+            {
+                trace::Scope scope("cursor", "main");
+                driveCursor(sim, f);
+            }
+            sim.update(FRAME_DT);
+            {
+                trace::Scope scope("surface", "main");
+                surface.update(sim);
+            }
+            renderer.render(sim, 640, 360);
+        }
+        return std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - start).count() / frames;
+    };
+
+    // Untraced runs on both sides of the traced one, so warm-up and drift
+    // do not count against tracing
+    double offMs = run(false);
+    double onMs = run(true);
+    trace::SessionStats stats = trace::stop(output);
+    offMs = std::min(offMs, run(false));
+    if (!stats.written) return 1;
+
+    std::cout << "  wrote " << stats.events << " events (" << stats.dropped << " dropped) on "
+              << stats.threads << " threads to " << output << std::endl
+              << std::fixed << std::setprecision(2)
+              << "  scope cost   " << offNanos << " ns off, " << onNanos << " ns recording" << std::endl
+              << "  tracing off  " << offMs << " ms/frame" << std::endl
+              << "  tracing on   " << onMs << " ms/frame, " << std::setprecision(0)
+              << static_cast<double>(stats.events) / frames << " events/frame" << std::endl;
+    return 0;
+}
+
+static void printUsage() {
+    std::cout << "Usage: hydration-headless <command> [options]" << std::endl;
+    std::cout << "Commands:" << std::endl;
+    std::cout << "  bench-lts [particles] [frames]   Uniform vs. local time stepping" << std::endl;
+    std::cout << "  bench-numa [particles] [frames] [threads]" << std::endl;
+    std::cout << "                                   NUMA-aware vs. default placement" << std::endl;
+    std::cout << "  bench-export [particles] [frames] Shared-memory export latency/throughput" << std::endl;
+    std::cout << "  bench-upload [particles] [frames] Float vs. packed particle upload (CPU side)" << std::endl;
+    std::cout << "  bench-adaptive [particles] [frames] Fixed vs. adaptive smoothing length" << std::endl;
+    std::cout << "  bench-resolution [particles] [frames]" << std::endl;
+    std::cout << "                                   Adaptive h vs. particle splitting/merging" << std::endl;
+    std::cout << "  bench-surface [particles] [frames] Density splat + surface extraction cost" << std::endl;
+    std::cout << "  bench-domain [particles] [frames] Sparse grid cost in box, channel and open domains" << std::endl;
+    std::cout << "  bench-wavefront [particles] [frames]" << std::endl;
+    std::cout << "                                   Phase-at-a-time vs. wavefront sub-steps" << std::endl;
+    std::cout << "  validate [particles] [frames] [tolerance]" << std::endl;
+    std::cout << "                                   Compare all execution paths to the reference" << std::endl;
+    std::cout << "  render [particles] [frames] [out.y4m|out.ppm|-] [width] [height] [surface]" << std::endl;
+    std::cout << "                                   CPU-rendered video of a simulation run" << std::endl;
+    std::cout << "  trace [particles] [frames] [out.json]" << std::endl;
+    std::cout << "                                   Chrome trace-event timeline of a run" << std::endl;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        printUsage();
+        return 1;
+    }
+
+    std::string command = argv[1];
+    auto intArg = [&](int index, int fallback) {
+        return argc > index ? std::atoi(argv[index]) : fallback;
+    };
+
+    if (command == "bench-lts") {
+        return benchLocalTimeStepping(intArg(2, 2000), intArg(3, 300));
+    }
+    if (command == "bench-numa") {
+        return benchNuma(intArg(2, 200000), intArg(3, 20), intArg(4, 0));
+    }
+    if (command == "bench-export") {
+        return benchExport(intArg(2, 2000), intArg(3, 300));
+    }
+    if (command == "bench-upload") {
+        return benchUpload(intArg(2, 1000000), intArg(3, 20));
+    }
+    if (command == "bench-adaptive") {
+        return benchAdaptive(intArg(2, 2000), intArg(3, 300));
+    }
+    if (command == "bench-resolution") {
+        return benchResolution(intArg(2, 2000), intArg(3, 600));
+    }
+    if (command == "bench-surface") {
+        return benchSurface(intArg(2, 1000000), intArg(3, 5));
+    }
+    if (command == "bench-domain") {
+        return benchDomain(intArg(2, 2000), intArg(3, 600));
+    }
+    if (command == "bench-wavefront") {
+        return benchWavefront(intArg(2, 1000000), intArg(3, 2));
+    }
+    if (command == "validate") {
+        double tolerance = argc > 4 ? std::atof(argv[4]) : 1e-4;
+        return validate(intArg(2, 2000), intArg(3, 5), tolerance);
+    }
+    if (command == "render") {
+        std::string output = argc > 4 ? argv[4] : "hydration.y4m";
+        return renderVideo(intArg(2, 2000), intArg(3, 300), output, intArg(5, 1280), intArg(6, 720),
+                           intArg(7, 0) != 0);
+    }
+    if (command == "trace") {
+        return traceFrames(intArg(2, 2000), intArg(3, 60), argc > 4 ? argv[4] : "hydration-trace.json");
+    }
+
+    printUsage();
+    return 1;
+}
@@ -1,11 +1,25 @@
 #include <iostream>
+#include <cstdio>
+#include <limits>
 #define GLFW_INCLUDE_GLCOREARB
 #include <GLFW/glfw3.h>
 #include "src/Simulation.h"
 #include "src/Renderer.h"
+#include "src/FrameGovernor.h"
+#include "src/FrameExporter.h"
+#include "src/DensityField.h"
+#include "src/Tracer.h"
+#include "src/View.h"
+
+static const char* const DEFAULT_TRACE_NAME = "hydration-trace.json";
 
 // --- Globals for callbacks ---
 static Simulation* g_sim = nullptr;
+static FrameGovernor* g_governor = nullptr;
+static FrameExporter* g_exporter = nullptr;
+static Renderer* g_renderer = nullptr;
+static bool g_surface = false;
+static int g_domain = 0;
 static bool g_mouseDown = false;
 static double g_mouseX = 0.0, g_mouseY = 0.0;
 static int g_winW = 1200, g_winH = 800;
@@ -25,6 +39,102 @@ void keyCallback(GLFWwindow* window, int key, int /*scancode*/, int action, int
             if (g_sim) g_sim->toggleGravity();
             std::cout << "[Hydration] Gravity toggled" << std::endl;
             break;
+        case GLFW_KEY_L:
+            if (g_sim) {
+                g_sim->setLocalTimeStepping(!g_sim->isLocalTimeStepping());
+                std::cout << "[Hydration] Local time stepping: "
+                          << (g_sim->isLocalTimeStepping() ? "ON" : "OFF") << std::endl;
+            }
+            break;
+        case GLFW_KEY_A:
+            if (g_sim) {
+                g_sim->setAdaptiveSmoothing(!g_sim->isAdaptiveSmoothing());
+                std::cout << "[Hydration] Adaptive smoothing length: "
+                          << (g_sim->isAdaptiveSmoothing() ? "ON" : "OFF") << std::endl;
+            }
+            break;
+        case GLFW_KEY_R:
+            if (g_sim) {
+                g_sim->setAdaptiveResolution(!g_sim->isAdaptiveResolution());
+                std::cout << "[Hydration] Adaptive resolution: "
+                          << (g_sim->isAdaptiveResolution() ? "ON" : "OFF") << std::endl;
+            }
+            break;
+        case GLFW_KEY_W:
+            if (g_sim) {
+                g_sim->setWavefront(!g_sim->isWavefront());
+                std::cout << "[Hydration] Wavefront sub-steps: "
+                          << (g_sim->isWavefront() ? "ON" : "OFF") << std::endl;
+            }
+            break;
+        case GLFW_KEY_S:
+            g_surface = !g_surface;
+            std::cout << "[Hydration] Free surface: " << (g_surface ? "ON" : "OFF") << std::endl;
+            break;
+        case GLFW_KEY_H:
+            if (g_sim) {
+                const auto& bins = g_sim->getTimeBinHistogram();
+                std::cout << "[Hydration] Time bins:";
+                for (int count : bins) std::cout << " " << count;
+                std::cout << std::endl;
+            }
+            break;
+        case GLFW_KEY_Q:
+            if (g_governor) {
+                g_governor->setEnabled(!g_governor->isEnabled());
+                std::cout << "[Hydration] Frame governor: "
+                          << (g_governor->isEnabled() ? "ON" : "OFF") << std::endl;
+            }
+            break;
+        case GLFW_KEY_E:
+            if (g_sim && g_exporter) {
+                if (g_exporter->isOpen()) {
+                    g_exporter->close();
+                    std::cout << "[Hydration] Frame export: OFF" << std::endl;
+                } else if (g_exporter->open(DEFAULT_EXPORT_NAME, g_sim->getParticleCount())) {
+                    std::cout << "[Hydration] Frame export: ON (" << DEFAULT_EXPORT_NAME << ")" << std::endl;
+                }
+            }
+            break;
+        case GLFW_KEY_D:
+            // Box -> long channel -> open floor; the fluid restarts in each
+            if (g_sim) {
+                g_domain = (g_domain + 1) % 3;
+                float inf = std::numeric_limits<float>::infinity();
+                const char* name = "box";
+                if (g_domain == 0) {
+                    g_sim->setDomain(glm::vec2(Simulation::DOMAIN_MIN), glm::vec2(Simulation::DOMAIN_MAX));
+                } else if (g_domain == 1) {
+                    g_sim->setDomain(glm::vec2(0.0f), glm::vec2(8.0f, 1.0f));
+                    name = "channel 8x1";
+                } else {
+                    g_sim->setDomain(glm::vec2(-inf, 0.0f), glm::vec2(inf));
+                    name = "open floor";
+                }
+                g_sim->reset();
+                std::cout << "[Hydration] Domain: " << name << std::endl;
+            }
+            break;
+        case GLFW_KEY_T:
+            if (trace::isEnabled()) {
+                trace::SessionStats stats = trace::stop(DEFAULT_TRACE_NAME);
+                std::cout << "[Hydration] Trace: OFF (" << stats.events << " events on "
+                          << stats.threads << " threads";
+                if (stats.dropped > 0) std::cout << ", " << stats.dropped << " dropped";
+                if (stats.written) std::cout << ", wrote " << DEFAULT_TRACE_NAME;
+                std::cout << ")" << std::endl;
+            } else {
+                trace::start();
+                std::cout << "[Hydration] Trace: ON" << std::endl;
+            }
+            break;
+        case GLFW_KEY_U:
+            if (g_renderer) {
+                g_renderer->setStreamingUpload(!g_renderer->isStreamingUpload());
+                std::cout << "[Hydration] Particle upload: "
+                          << (g_renderer->isStreamingUpload() ? "streaming (packed)" : "float") << std::endl;
+            }
+            break;
         case GLFW_KEY_UP:
             if (g_sim) g_sim->setGravityDirection(0.0f, 9.81f);
             std::cout << "[Hydration] Gravity: UP" << std::endl;
@@ -63,25 +173,13 @@ void framebufferSizeCallback(GLFWwindow* /*window*/, int width, int height) {
 // Convert screen coords to simulation domain [0,1]x[0,1]
 glm::vec2 screenToSim(double sx, double sy) {
     // Account for the same padding/aspect used in Renderer
-    float aspect = static_cast<float>(g_winW) / static_cast<float>(g_winH);
-    float padding = 0.05f;
+    View view = fitView(*g_sim, g_winW, g_winH);
     
     float normX = static_cast<float>(sx) / static_cast<float>(g_winW);
     float normY = 1.0f - static_cast<float>(sy) / static_cast<float>(g_winH); // flip Y
     
-    float simX, simY;
-    if (aspect >= 1.0f) {
-        float halfW = (0.5f + padding) * aspect;
-        float halfH = 0.5f + padding;
-        simX = (normX - 0.5f) * 2.0f * halfW + 0.5f;
-        simY = (normY - 0.5f) * 2.0f * halfH + 0.5f;
-    } else {
-        float halfW = 0.5f + padding;
-        float halfH = (0.5f + padding) / aspect;
-        simX = (normX - 0.5f) * 2.0f * halfW + 0.5f;
-        simY = (normY - 0.5f) * 2.0f * halfH + 0.5f;
-    }
-    
+    float simX = (normX - 0.5f) * 2.0f * view.halfExtent.x + view.center.x;
+    float simY = (normY - 0.5f) * 2.0f * view.halfExtent.y + view.center.y;
     return glm::vec2(simX, simY);
 }
 
@@ -125,12 +223,23 @@ int main() {
     Simulation sim(2000);
     g_sim = &sim;
     
+    FrameGovernor governor;
+    g_governor = &governor;
+    governor.apply(sim);
+    
+    FrameExporter exporter;
+    g_exporter = &exporter;
+    
     Renderer renderer;
     if (!renderer.init("shaders")) {
         std::cerr << "Failed to initialize renderer" << std::endl;
         glfwTerminate();
         return -1;
     }
+    g_renderer = &renderer;
+    
+    DensityField surface;
+    trace::setThreadName("main");
     
     std::cout << "=== Hydration Physics Simulation ===" << std::endl;
     std::cout << "Controls:" << std::endl;
@@ -138,13 +247,26 @@ int main() {
     std::cout << "  Space            - Reset simulation" << std::endl;
     std::cout << "  G                - Toggle gravity (flip)" << std::endl;
     std::cout << "  Arrow keys       - Change gravity direction" << std::endl;
+    std::cout << "  L                - Toggle local time stepping" << std::endl;
+    std::cout << "  A                - Toggle adaptive smoothing length" << std::endl;
+    std::cout << "  R                - Toggle adaptive resolution (split/merge)" << std::endl;
+    std::cout << "  W                - Toggle cache-blocked wavefront sub-steps" << std::endl;
+    std::cout << "  S                - Toggle free-surface contours" << std::endl;
+    std::cout << "  H                - Print time bin histogram" << std::endl;
+    std::cout << "  Q                - Toggle frame governor" << std::endl;
+    std::cout << "  E                - Toggle shared-memory frame export" << std::endl;
+    std::cout << "  U                - Toggle streaming/float particle upload" << std::endl;
+    std::cout << "  T                - Start/stop timeline trace (Chrome JSON)" << std::endl;
+    std::cout << "  D                - Cycle domain (box, long channel, open floor)" << std::endl;
     std::cout << "  Escape           - Quit" << std::endl;
     std::cout << "====================================" << std::endl;
     
     double lastTime = glfwGetTime();
+    double lastTitleTime = lastTime;
     
     // Main loop
     while (!glfwWindowShouldClose(window)) {
+        trace::Scope frameScope("frame", "main");
         double currentTime = glfwGetTime();
         float dt = static_cast<float>(currentTime - lastTime);
         lastTime = currentTime;
@@ -156,10 +278,24 @@ int main() {
         glm::vec2 cursorSim = screenToSim(g_mouseX, g_mouseY);
         
         // Cursor always repels particles wherever it touches
-        sim.applyCursorForce(cursorSim.x, cursorSim.y, false);
+        {
+            trace::Scope scope("cursor", "main");
+            sim.applyCursorForce(cursorSim.x, cursorSim.y, false);
+        }
         
         // Update simulation
+        double updateStart = glfwGetTime();
         sim.update(dt);
+        {
+            trace::Scope scope("export", "main");
+            exporter.publish(sim);
+        }
+        if (g_surface) {
+            trace::Scope scope("surface", "main");
+            surface.update(sim);
+        }
+        renderer.setSurface(g_surface ? &surface : nullptr);
+        double updateEnd = glfwGetTime();
         
         // Get framebuffer size for rendering
         glfwGetFramebufferSize(window, &g_winW, &g_winH);
@@ -167,12 +303,38 @@ int main() {
         // Render
         glClear(GL_COLOR_BUFFER_BIT);
         renderer.render(sim, g_winW, g_winH);
+        double renderEnd = glfwGetTime();
+        
+        // Adapt quality for the next frame
+        governor.recordFrame(updateEnd - updateStart, renderEnd - updateEnd);
+        governor.apply(sim);
+        renderer.setDecimation(governor.getQuality().renderDecimation);
         
-        glfwSwapBuffers(window);
+        if (renderEnd - lastTitleTime > 0.5) {
+            lastTitleTime = renderEnd;
+            char title[160];
+            std::snprintf(title, sizeof(title),
+                          "Hydration Physics | quality %d/%d | headroom %d%% | render %.2f ms (%s)",
+                          governor.getLevel(), FrameGovernor::LEVEL_COUNT - 1,
+                          static_cast<int>(governor.getHeadroom() * 100.0),
+                          governor.getRenderTime() * 1000.0,
+                          renderer.isStreamingUpload() ? "stream" : "float");
+            glfwSetWindowTitle(window, title);
+        }
+        
+        {
+            trace::Scope scope("swap", "main");
+            glfwSwapBuffers(window);
+        }
         glfwPollEvents();
     }
     
+    if (trace::isEnabled()) trace::stop(DEFAULT_TRACE_NAME);
+    
     g_sim = nullptr;
+    g_governor = nullptr;
+    g_exporter = nullptr;
+    g_renderer = nullptr;
     glfwDestroyWindow(window);
     glfwTerminate();
     
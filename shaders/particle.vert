@@ -1,20 +1,25 @@
 #version 330 core
 
+// Streamed particles arrive packed (see src/ParticlePacking.h): aPos is a
+// 16-bit normalized position within the domain, aVel/aDensity/aSize are halfs
 layout (location = 0) in vec2 aPos;
 layout (location = 1) in vec2 aVel;
 layout (location = 2) in float aDensity;
+layout (location = 3) in float aSize;   // sqrt(mass / base mass): area follows mass
 
 uniform mat4 projection;
 uniform float pointSize;
+uniform vec2 positionOffset;   // Domain minimum (0 for unpacked positions)
+uniform vec2 positionScale;    // Domain size (1 for unpacked positions)
 
 out float vSpeed;
 out float vDensity;
 
 void main() {
-    gl_Position = projection * vec4(aPos, 0.0, 1.0);
+    gl_Position = projection * vec4(positionOffset + aPos * positionScale, 0.0, 1.0);
     
     vSpeed = length(aVel);
     vDensity = aDensity;
     
-    gl_PointSize = pointSize;
+    gl_PointSize = pointSize * aSize;
 }
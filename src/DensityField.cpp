@@ -0,0 +1,317 @@
+#include "DensityField.h"
+#include "Tracer.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <limits>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+// Marching-squares segments per corner case, as pairs of cell edges
+// (0 bottom, 1 right, 2 top, 3 left); corners inside the fluid set bits
+// 1 bottom-left, 2 bottom-right, 4 top-right, 8 top-left. The saddles 5
+// and 10 are resolved by the cell center in contourTile.
+static const int CASE_EDGES[16][2] = {
+    { -1, -1 }, { 3, 0 }, { 0, 1 }, { 3, 1 },
+    { 1, 2 },   { -1, -1 }, { 0, 2 }, { 3, 2 },
+    { 2, 3 },   { 0, 2 }, { -1, -1 }, { 1, 2 },
+    { 1, 3 },   { 0, 1 }, { 3, 0 }, { -1, -1 },
+};
+
+// Without SSE4.1, std::floor/std::ceil are library calls
+static inline int floorToInt(float v) {
+    int i = static_cast<int>(v);
+    return i - (v < static_cast<float>(i) ? 1 : 0);
+}
+
+static inline int ceilToInt(float v) {
+    int i = static_cast<int>(v);
+    return i + (v > static_cast<float>(i) ? 1 : 0);
+}
+
+DensityField::DensityField(int threads)
+    : pool(std::make_unique<ThreadPool>(threads, false, "surface worker")) {}
+
+DensityField::~DensityField() = default;
+
+void DensityField::resize(int w, int h) {
+    width = w;
+    height = h;
+    tilesX = (w + TILE_SIZE - 1) / TILE_SIZE;
+    tilesY = (h + TILE_SIZE - 1) / TILE_SIZE;
+    int tileCount = tilesX * tilesY;
+
+    values.assign(static_cast<size_t>(w) * h, 0.0f);
+    tileOccupied.assign(tileCount, 0);
+    tileActive.assign(tileCount, 0);
+    tileSegments.assign(tileCount, {});
+    bins.assign(pool->getThreadCount(), std::vector<std::vector<Splat>>(tileCount));
+}
+
+void DensityField::update(const Simulation& sim) {
+    // Nodes cover the fluid plus the largest support, so the field reaches
+    // zero inside the grid and contours never run off its edge
+    float h0 = sim.getSmoothingRadius();
+    float maxH = sim.isAdaptiveSmoothing() ? h0 * Simulation::ADAPTIVE_H_MAX : h0;
+    float cs = h0 * cellScale;
+    float margin = maxH + cs;
+    glm::vec2 lo, hi;
+    {
+        trace::Scope scope("bounds", "surface");
+        measureFluid(sim, lo, hi);
+    }
+
+    // Whole tiles of a lattice fixed in space, laid out with a tile of slack
+    // on every side; the layout (and its skipped tiles) is kept while the
+    // fluid moves within it, until the fluid leaves it or needs only a
+    // quarter of it
+    float tileSpan = cs * TILE_SIZE;
+    int layoutStart[2] = { tileX0, tileY0 };
+    int layoutTiles[2] = { tilesX, tilesY };
+    int first[2], end[2];
+    bool covers = cs == cellSize;
+    long long neededTiles = 1;
+    for (int axis = 0; axis < 2; axis++) {
+        int needFirst = floorToInt((lo[axis] - margin) / tileSpan);
+        int needEnd = ceilToInt((hi[axis] + margin) / tileSpan);
+        covers = covers && needFirst >= layoutStart[axis] && needEnd <= layoutStart[axis] + layoutTiles[axis];
+
+        // Slack past a wall would never fill
+        float wallMin = sim.getDomainMin()[axis];
+        float wallMax = sim.getDomainMax()[axis];
+        first[axis] = needFirst - 1;
+        end[axis] = needEnd + 1;
+        if (std::isfinite(wallMin)) first[axis] = std::max(first[axis], floorToInt((wallMin - margin) / tileSpan));
+        if (std::isfinite(wallMax)) end[axis] = std::min(end[axis], ceilToInt((wallMax + margin) / tileSpan));
+        neededTiles *= end[axis] - first[axis];
+    }
+    if (!covers || static_cast<long long>(tilesX) * tilesY > 4 * neededTiles) {
+        cellSize = cs;
+        tileX0 = first[0];
+        tileY0 = first[1];
+        origin = glm::vec2(static_cast<float>(tileX0) * tileSpan, static_cast<float>(tileY0) * tileSpan);
+        resize((end[0] - first[0]) * TILE_SIZE, (end[1] - first[1]) * TILE_SIZE);
+    }
+    isoLevel = isoFraction * sim.getRestDensity();
+
+    {
+        trace::Scope scope("bin", "surface");
+        binParticles(sim);
+    }
+
+    // Tiles are claimed dynamically since the fluid covers only part of the
+    // grid; each writes only its own nodes
+    int tileCount = tilesX * tilesY;
+    std::atomic<int> nextTile{0};
+    {
+        trace::Scope scope("splat", "surface");
+        pool->run(pool->getThreadCount(), [&](int, int, int) {
+            for (int tile = nextTile++; tile < tileCount; tile = nextTile++) {
+                splatTile(tile);
+            }
+        });
+    }
+
+    // Contouring reads the neighboring tiles' edge nodes, so it starts once
+    // every tile is splatted
+    trace::Scope contourScope("contour", "surface");
+    nextTile = 0;
+    pool->run(pool->getThreadCount(), [&](int, int, int) {
+        for (int tile = nextTile++; tile < tileCount; tile = nextTile++) {
+            contourTile(tile);
+        }
+    });
+
+    segments.clear();
+    activeTiles = 0;
+    for (int tile = 0; tile < tileCount; tile++) {
+        segments.insert(segments.end(), tileSegments[tile].begin(), tileSegments[tile].end());
+        activeTiles += tileActive[tile];
+    }
+}
+
+// Exact particle bounds; the simulation's are as of its last grid rebuild,
+// a sub-step behind the positions
+void DensityField::measureFluid(const Simulation& sim, glm::vec2& lo, glm::vec2& hi) {
+    const auto& particles = sim.getParticles();
+    float inf = std::numeric_limits<float>::infinity();
+    std::vector<glm::vec2> workerLo(pool->getThreadCount(), glm::vec2(inf));
+    std::vector<glm::vec2> workerHi(pool->getThreadCount(), glm::vec2(-inf));
+    pool->run(sim.getParticleCount(), [&](int worker, int begin, int end) {
+        glm::vec2 l = workerLo[worker];
+        glm::vec2 u = workerHi[worker];
+        for (int k = begin; k < end; k++) {
+            l = glm::min(l, particles[k].position);
+            u = glm::max(u, particles[k].position);
+        }
+        workerLo[worker] = l;
+        workerHi[worker] = u;
+    });
+
+    lo = glm::vec2(inf);
+    hi = glm::vec2(-inf);
+    for (size_t w = 0; w < workerLo.size(); w++) {
+        lo = glm::min(lo, workerLo[w]);
+        hi = glm::max(hi, workerHi[w]);
+    }
+    // No particles: a minimal grid at the origin
+    if (lo.x > hi.x) {
+        lo = glm::vec2(0.0f);
+        hi = glm::vec2(0.0f);
+    }
+}
+
+// Reduces every particle to a Splat and files it under each tile its support
+// overlaps. Workers own contiguous particle slices, so walking the bins in
+// worker order visits particles in index order for any thread count.
+void DensityField::binParticles(const Simulation& sim) {
+    const auto& particles = sim.getParticles();
+    int count = sim.getParticleCount();
+    float invCell = 1.0f / cellSize;
+    float cell2 = cellSize * cellSize;
+    float cell6 = cell2 * cell2 * cell2;
+
+    // Cleared up front: workers with an empty slice are never called
+    for (auto& workerBins : bins) {
+        for (auto& bin : workerBins) bin.clear();
+    }
+    pool->run(count, [&](int worker, int begin, int end) {
+        for (int k = begin; k < end; k++) {
+            const Particle& p = particles[k];
+            float h2 = p.smoothingLength * p.smoothingLength;
+            Splat s;
+            s.x = (p.position.x - origin.x) * invCell;
+            s.y = (p.position.y - origin.y) * invCell;
+            s.radius = p.smoothingLength * invCell;
+            // (h² - r²)³ = cell⁶ (radius² - d²)³ with d in node units
+            s.weight = p.mass * 4.0f / (static_cast<float>(M_PI) * h2 * h2 * h2 * h2) * cell6;
+
+            int i0 = std::max(0, ceilToInt(s.x - s.radius));
+            int i1 = std::min(width - 1, floorToInt(s.x + s.radius));
+            int j0 = std::max(0, ceilToInt(s.y - s.radius));
+            int j1 = std::min(height - 1, floorToInt(s.y + s.radius));
+            if (i0 > i1 || j0 > j1) continue;
+
+            for (int ty = j0 / TILE_SIZE; ty <= j1 / TILE_SIZE; ty++) {
+                for (int tx = i0 / TILE_SIZE; tx <= i1 / TILE_SIZE; tx++) {
+                    bins[worker][ty * tilesX + tx].push_back(s);
+                }
+            }
+        }
+    });
+}
+
+void DensityField::splatTile(int tile) {
+    bool occupied = false;
+    for (const auto& workerBins : bins) {
+        if (!workerBins[tile].empty()) {
+            occupied = true;
+            break;
+        }
+    }
+    // Still zero from the last update
+    if (!occupied && !tileOccupied[tile]) return;
+    tileOccupied[tile] = occupied;
+
+    int nx0 = (tile % tilesX) * TILE_SIZE;
+    int ny0 = (tile / tilesX) * TILE_SIZE;
+    int nx1 = std::min(nx0 + TILE_SIZE, width);
+    int ny1 = std::min(ny0 + TILE_SIZE, height);
+    for (int j = ny0; j < ny1; j++) {
+        float* row = values.data() + static_cast<size_t>(j) * width;
+        std::fill(row + nx0, row + nx1, 0.0f);
+    }
+
+    // Poly6: W = coeff * (h² - r²)³ over the support's bounding square,
+    // clamped to zero outside the circle so the inner loop has no branch
+    for (const auto& workerBins : bins) {
+        for (const Splat& s : workerBins[tile]) {
+            float r2 = s.radius * s.radius;
+            int i0 = std::max(nx0, ceilToInt(s.x - s.radius));
+            int i1 = std::min(nx1 - 1, floorToInt(s.x + s.radius));
+            int j0 = std::max(ny0, ceilToInt(s.y - s.radius));
+            int j1 = std::min(ny1 - 1, floorToInt(s.y + s.radius));
+
+            for (int j = j0; j <= j1; j++) {
+                float dy = static_cast<float>(j) - s.y;
+                float remaining = r2 - dy * dy;
+                float* row = &values[static_cast<size_t>(j) * width];
+                for (int i = i0; i <= i1; i++) {
+                    float dx = static_cast<float>(i) - s.x;
+                    float d = std::max(remaining - dx * dx, 0.0f);
+                    row[i] += s.weight * d * d * d;
+                }
+            }
+        }
+    }
+}
+
+// Cells of a tile also read the first nodes of the tiles to the right and
+// above, so the tile is contoured if any of the four holds fluid
+bool DensityField::tileNeedsContour(int tx, int ty) const {
+    for (int dy = 0; dy <= 1 && ty + dy < tilesY; dy++) {
+        for (int dx = 0; dx <= 1 && tx + dx < tilesX; dx++) {
+            if (tileOccupied[(ty + dy) * tilesX + tx + dx]) return true;
+        }
+    }
+    return false;
+}
+
+void DensityField::contourTile(int tile) {
+    std::vector<SurfaceSegment>& out = tileSegments[tile];
+    out.clear();
+
+    int tx = tile % tilesX;
+    int ty = tile / tilesX;
+    tileActive[tile] = tileNeedsContour(tx, ty);
+    if (!tileActive[tile]) return;
+
+    // Cell (i, j) spans nodes (i, j) .. (i + 1, j + 1)
+    int cx0 = tx * TILE_SIZE;
+    int cy0 = ty * TILE_SIZE;
+    int cx1 = std::min(cx0 + TILE_SIZE, width - 1);
+    int cy1 = std::min(cy0 + TILE_SIZE, height - 1);
+    float iso = isoLevel;
+
+    for (int j = cy0; j < cy1; j++) {
+        const float* below = &values[static_cast<size_t>(j) * width];
+        const float* above = below + width;
+        for (int i = cx0; i < cx1; i++) {
+            float v0 = below[i];        // Bottom-left
+            float v1 = below[i + 1];    // Bottom-right
+            float v2 = above[i + 1];    // Top-right
+            float v3 = above[i];        // Top-left
+            int index = (v0 >= iso ? 1 : 0) | (v1 >= iso ? 2 : 0) | (v2 >= iso ? 4 : 0) | (v3 >= iso ? 8 : 0);
+            if (index == 0 || index == 15) continue;
+
+            float x = origin.x + static_cast<float>(i) * cellSize;
+            float y = origin.y + static_cast<float>(j) * cellSize;
+            auto edgePoint = [&](int edge) {
+                switch (edge) {
+                    case 0: return glm::vec2(x + (iso - v0) / (v1 - v0) * cellSize, y);
+                    case 1: return glm::vec2(x + cellSize, y + (iso - v1) / (v2 - v1) * cellSize);
+                    case 2: return glm::vec2(x + (iso - v3) / (v2 - v3) * cellSize, y + cellSize);
+                    default: return glm::vec2(x, y + (iso - v0) / (v3 - v0) * cellSize);
+                }
+            };
+
+            if (index == 5 || index == 10) {
+                // Saddle: a center inside the fluid joins the two inside
+                // corners, so the outside corners are cut off instead
+                bool centerInside = (v0 + v1 + v2 + v3) * 0.25f >= iso;
+                bool cutBottomRight = (index == 5) == centerInside;
+                if (cutBottomRight) {
+                    out.push_back({ edgePoint(0), edgePoint(1) });
+                    out.push_back({ edgePoint(2), edgePoint(3) });
+                } else {
+                    out.push_back({ edgePoint(3), edgePoint(0) });
+                    out.push_back({ edgePoint(1), edgePoint(2) });
+                }
+                continue;
+            }
+            out.push_back({ edgePoint(CASE_EDGES[index][0]), edgePoint(CASE_EDGES[index][1]) });
+        }
+    }
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+#include <glm/glm.hpp>
+#include "Simulation.h"
+#include "ThreadPool.h"
+
+// One marching-squares line segment of the free surface, in simulation
+// coordinates
+struct SurfaceSegment {
+    glm::vec2 a, b;
+};
+
+static_assert(sizeof(SurfaceSegment) == 4 * sizeof(float), "Renderer uploads segments as GL_LINES vertices");
+
+// Density sampled on a regular grid of nodes, splatted from the particles
+// with the Poly6 kernel of each particle's own h (the estimate the density
+// phase computes), and the free surface extracted from it as marching-
+// squares contours at an iso density. The grid is split into tiles; every
+// tile sums the particles overlapping it into its own nodes only, so
+// workers never write shared memory and the result does not depend on the
+// thread count. The grid covers the fluid's bounds rather than the domain,
+// so its memory follows the area the fluid spans. Storage persists between
+// updates, and tiles the fluid has not reached since the last update are
+// skipped.
+class DensityField {
+public:
+    // threads = 0 uses every hardware thread
+    explicit DensityField(int threads = 0);
+    ~DensityField();
+
+    // Splats the current particles and re-extracts the surface
+    void update(const Simulation& sim);
+
+    // Node spacing as a fraction of the base h (default 0.5)
+    void setCellScale(float scale) { cellScale = scale > 0.05f ? scale : 0.05f; }
+    float getCellScale() const { return cellScale; }
+    // Surface iso level as a fraction of the rest density (default 0.5)
+    void setIsoFraction(float fraction) { isoFraction = fraction; }
+    float getIsoFraction() const { return isoFraction; }
+
+    // Nodes are row-major from the lowest y; node (i, j) sits at
+    // origin + (i, j) * cellSize. The grid extends past the fluid's bounds
+    // by at least the largest kernel support, so every contour closes.
+    const std::vector<float>& getValues() const { return values; }
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+    glm::vec2 getOrigin() const { return origin; }
+    float getCellSize() const { return cellSize; }
+    float getIsoLevel() const { return isoLevel; }
+
+    // Unordered segments, grouped by tile
+    const std::vector<SurfaceSegment>& getSegments() const { return segments; }
+
+    // Tiles splatted or contoured by the last update, of getTileCount()
+    int getActiveTileCount() const { return activeTiles; }
+    int getTileCount() const { return tilesX * tilesY; }
+    int getThreadCount() const { return pool->getThreadCount(); }
+
+private:
+    static constexpr int TILE_SIZE = 32;   // Nodes per tile side
+
+    // Particle reduced to what the splat reads, in units of the node
+    // spacing: position, support radius and m * Poly6 coefficient * cell⁶
+    struct Splat {
+        float x, y;
+        float radius;
+        float weight;
+    };
+
+    std::unique_ptr<ThreadPool> pool;
+    float cellScale = 0.5f;
+    float isoFraction = 0.5f;
+
+    int width = 0;
+    int height = 0;
+    int tilesX = 0;
+    int tilesY = 0;
+    int tileX0 = 0;                        // First tile on the fixed lattice
+    int tileY0 = 0;
+    glm::vec2 origin{0.0f};
+    float cellSize = 0.0f;
+    float isoLevel = 0.0f;
+    int activeTiles = 0;
+
+    std::vector<float> values;
+    // Splats are copied into every tile they overlap, so each tile streams
+    // through its own particles in order instead of gathering them
+    std::vector<std::vector<std::vector<Splat>>> bins; // [worker][tile] -> splats
+    std::vector<uint8_t> tileOccupied;                 // Tile holds nonzero nodes
+    std::vector<uint8_t> tileActive;                   // Contoured this update
+    std::vector<std::vector<SurfaceSegment>> tileSegments;
+    std::vector<SurfaceSegment> segments;
+
+    void resize(int w, int h);
+    void measureFluid(const Simulation& sim, glm::vec2& lo, glm::vec2& hi);
+    void binParticles(const Simulation& sim);
+    void splatTile(int tile);
+    void contourTile(int tile);
+    bool tileNeedsContour(int tx, int ty) const;
+};
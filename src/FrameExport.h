@@ -0,0 +1,61 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <time.h>
+
+// Shared-memory layout for live frame export. The segment holds one
+// ExportHeader followed by slotCount slots; each slot is a SlotHeader
+// followed by the particle arrays described in ExportHeader::fields.
+// Writers publish into the ring round-robin and readers pick the newest
+// slot, validating their read with the slot's sequence counter (seqlock).
+
+static const char EXPORT_MAGIC[8] = { 'H', 'Y', 'D', 'R', 'S', 'H', 'M', '\0' };
+static const uint32_t EXPORT_VERSION = 1;
+static const char* const DEFAULT_EXPORT_NAME = "/hydration";
+
+enum ExportFieldType : uint32_t {
+    EXPORT_FLOAT32 = 1,
+};
+
+// One array in a slot: element i lives at slot + offset + i * stride
+struct ExportField {
+    char name[16];
+    uint32_t type;          // ExportFieldType
+    uint32_t components;
+    uint32_t offset;        // From the start of the slot (after the slot header)
+    uint32_t stride;        // Bytes between consecutive particles
+};
+
+static const int EXPORT_MAX_FIELDS = 8;
+
+struct ExportHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t headerSize;
+    uint32_t slotCount;
+    uint32_t slotSize;      // Bytes per slot including its SlotHeader
+    uint32_t capacity;      // Particles each slot can hold
+    uint32_t fieldCount;
+    ExportField fields[EXPORT_MAX_FIELDS];
+    std::atomic<uint64_t> publishedFrames;  // Newest slot = (publishedFrames - 1) % slotCount
+};
+
+struct SlotHeader {
+    std::atomic<uint64_t> sequence;  // Odd while the writer is inside the slot
+    uint64_t frameIndex;
+    double simTime;
+    uint64_t publishNanos;           // exportClockNanos() at publish
+    uint32_t count;
+    uint32_t padding;
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free,
+              "shared-memory counters must be address-free");
+
+// Monotonic clock shared by all processes on the machine
+inline uint64_t exportClockNanos() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ull + static_cast<uint64_t>(ts.tv_nsec);
+}
@@ -0,0 +1,139 @@
+#include "FrameExporter.h"
+#include "Simulation.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+// Position (vec2) + Velocity (vec2) + Density (float), stored as separate
+// arrays so readers can take any one of them with a plain stride
+static const uint32_t FIELD_POSITION = 0;
+static const uint32_t FIELD_VELOCITY = 1;
+static const uint32_t FIELD_DENSITY = 2;
+
+static void setField(ExportField& field, const char* name, uint32_t components,
+                     uint32_t offset) {
+    std::memset(field.name, 0, sizeof(field.name));
+    std::strncpy(field.name, name, sizeof(field.name) - 1);
+    field.type = EXPORT_FLOAT32;
+    field.components = components;
+    field.offset = offset;
+    field.stride = components * sizeof(float);
+}
+
+static uint32_t alignUp(uint32_t value, uint32_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+FrameExporter::FrameExporter() {}
+
+FrameExporter::~FrameExporter() {
+    close();
+}
+
+bool FrameExporter::open(const std::string& segmentName, int capacity, int slotCount) {
+    close();
+
+    uint32_t n = static_cast<uint32_t>(capacity);
+    uint32_t headerSize = alignUp(sizeof(ExportHeader), 64);
+    uint32_t dataOffset = alignUp(sizeof(SlotHeader), 64);
+    uint32_t velocityOffset = alignUp(dataOffset + n * 2 * sizeof(float), 64);
+    uint32_t densityOffset = alignUp(velocityOffset + n * 2 * sizeof(float), 64);
+    uint32_t slotSize = alignUp(densityOffset + n * sizeof(float), 64);
+    size_t bytes = headerSize + static_cast<size_t>(slotSize) * slotCount;
+
+    // Replace any stale segment so its size and layout match ours
+    shm_unlink(segmentName.c_str());
+    int fd = shm_open(segmentName.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd < 0) {
+        std::cerr << "ERROR::EXPORT: shm_open failed for " << segmentName << std::endl;
+        return false;
+    }
+    if (ftruncate(fd, static_cast<off_t>(bytes)) != 0) {
+        std::cerr << "ERROR::EXPORT: ftruncate failed for " << segmentName << std::endl;
+        ::close(fd);
+        shm_unlink(segmentName.c_str());
+        return false;
+    }
+
+    void* ptr = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (ptr == MAP_FAILED) {
+        std::cerr << "ERROR::EXPORT: mmap failed for " << segmentName << std::endl;
+        shm_unlink(segmentName.c_str());
+        return false;
+    }
+
+    name = segmentName;
+    mappedBytes = bytes;
+    header = static_cast<ExportHeader*>(ptr);
+
+    header->version = EXPORT_VERSION;
+    header->headerSize = headerSize;
+    header->slotCount = static_cast<uint32_t>(slotCount);
+    header->slotSize = slotSize;
+    header->capacity = n;
+    header->fieldCount = 3;
+    setField(header->fields[FIELD_POSITION], "position", 2, dataOffset);
+    setField(header->fields[FIELD_VELOCITY], "velocity", 2, velocityOffset);
+    setField(header->fields[FIELD_DENSITY], "density", 1, densityOffset);
+    header->publishedFrames.store(0, std::memory_order_relaxed);
+    for (uint32_t s = 0; s < header->slotCount; s++) {
+        slot(s)->sequence.store(0, std::memory_order_relaxed);
+    }
+
+    // Readers check the magic last, so they never see a half-built header
+    std::atomic_thread_fence(std::memory_order_release);
+    std::memcpy(header->magic, EXPORT_MAGIC, sizeof(EXPORT_MAGIC));
+    return true;
+}
+
+void FrameExporter::close() {
+    if (!header) return;
+    munmap(header, mappedBytes);
+    shm_unlink(name.c_str());
+    header = nullptr;
+    mappedBytes = 0;
+}
+
+SlotHeader* FrameExporter::slot(uint32_t index) const {
+    char* base = reinterpret_cast<char*>(header) + header->headerSize;
+    return reinterpret_cast<SlotHeader*>(base + static_cast<size_t>(index) * header->slotSize);
+}
+
+void FrameExporter::publish(const Simulation& sim) {
+    if (!header) return;
+
+    uint64_t frame = header->publishedFrames.load(std::memory_order_relaxed);
+    SlotHeader* s = slot(static_cast<uint32_t>(frame % header->slotCount));
+    char* data = reinterpret_cast<char*>(s);
+
+    const auto& particles = sim.getParticles();
+    uint32_t count = std::min(static_cast<uint32_t>(particles.size()), header->capacity);
+
+    // Seqlock write: odd sequence marks the slot as in flux
+    uint64_t seq = s->sequence.load(std::memory_order_relaxed);
+    s->sequence.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    float* positions = reinterpret_cast<float*>(data + header->fields[FIELD_POSITION].offset);
+    float* velocities = reinterpret_cast<float*>(data + header->fields[FIELD_VELOCITY].offset);
+    float* densities = reinterpret_cast<float*>(data + header->fields[FIELD_DENSITY].offset);
+    for (uint32_t i = 0; i < count; i++) {
+        positions[i * 2 + 0] = particles[i].position.x;
+        positions[i * 2 + 1] = particles[i].position.y;
+        velocities[i * 2 + 0] = particles[i].velocity.x;
+        velocities[i * 2 + 1] = particles[i].velocity.y;
+        densities[i] = particles[i].density;
+    }
+
+    s->frameIndex = static_cast<uint64_t>(sim.getFrameIndex());
+    s->simTime = sim.getSimTime();
+    s->count = count;
+    s->publishNanos = exportClockNanos();
+
+    s->sequence.store(seq + 2, std::memory_order_release);
+    header->publishedFrames.store(frame + 1, std::memory_order_release);
+}
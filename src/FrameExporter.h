@@ -0,0 +1,33 @@
+#pragma once
+
+#include <string>
+#include <cstddef>
+#include "FrameExport.h"
+
+class Simulation;
+
+// Publishes simulation frames into a POSIX shared-memory ring buffer (see
+// FrameExport.h) so other processes can map them without copies or locks.
+class FrameExporter {
+public:
+    FrameExporter();
+    ~FrameExporter();
+
+    FrameExporter(const FrameExporter&) = delete;
+    FrameExporter& operator=(const FrameExporter&) = delete;
+
+    // Creates (or replaces) the segment; capacity is the max particle count
+    bool open(const std::string& name, int capacity, int slotCount = 4);
+    void close();
+    bool isOpen() const { return header != nullptr; }
+
+    // Copies the current particle state into the next ring slot
+    void publish(const Simulation& sim);
+
+private:
+    std::string name;
+    ExportHeader* header = nullptr;
+    size_t mappedBytes = 0;
+
+    SlotHeader* slot(uint32_t index) const;
+};
@@ -0,0 +1,77 @@
+#include "FrameGovernor.h"
+#include "Simulation.h"
+
+// Ordered from cheapest (0) to full quality (LEVEL_COUNT - 1). Neighbor lists
+// are always cached; reusing them across sub-steps is only safe with 4 of them.
+static const FrameGovernor::QualityLevel QUALITY_LADDER[FrameGovernor::LEVEL_COUNT] = {
+    // substeps, xsph, neighborListInterval, renderDecimation
+    { 2, false, 1, 4 },
+    { 3, false, 1, 2 },
+    { 4, false, 2, 1 },
+    { 4, false, 1, 1 },
+    { 4, true,  1, 1 },
+};
+
+FrameGovernor::FrameGovernor(double targetFrameTime)
+    : targetFrameTime(targetFrameTime) {}
+
+void FrameGovernor::recordFrame(double updateSeconds, double renderSeconds) {
+    if (!hasSample) {
+        smoothedUpdate = updateSeconds;
+        smoothedRender = renderSeconds;
+        hasSample = true;
+    } else {
+        smoothedUpdate += smoothing * (updateSeconds - smoothedUpdate);
+        smoothedRender += smoothing * (renderSeconds - smoothedRender);
+    }
+
+    if (!enabled) return;
+
+    if (cooldown > 0) {
+        cooldown--;
+        return;
+    }
+
+    double cost = smoothedUpdate + smoothedRender;
+    double budget = targetFrameTime * budgetFraction;
+
+    if (cost > budget) {
+        framesUnderBudget = 0;
+        if (level > 0) {
+            level--;
+            cooldown = SETTLE_FRAMES;
+        }
+    } else if (cost < budget * raiseFraction && level < LEVEL_COUNT - 1) {
+        if (++framesUnderBudget >= RAISE_FRAMES) {
+            framesUnderBudget = 0;
+            level++;
+            cooldown = SETTLE_FRAMES;
+        }
+    } else {
+        framesUnderBudget = 0;
+    }
+}
+
+void FrameGovernor::apply(Simulation& sim) const {
+    const QualityLevel& q = getQuality();
+    sim.setSubsteps(q.substeps);
+    sim.setXSPHEnabled(q.xsph);
+    if (sim.getNeighborListInterval() != q.neighborListInterval) {
+        sim.setNeighborListInterval(q.neighborListInterval);
+    }
+}
+
+void FrameGovernor::setEnabled(bool enable) {
+    enabled = enable;
+    level = LEVEL_COUNT - 1;
+    cooldown = SETTLE_FRAMES;
+    framesUnderBudget = 0;
+}
+
+const FrameGovernor::QualityLevel& FrameGovernor::getQuality() const {
+    return QUALITY_LADDER[level];
+}
+
+double FrameGovernor::getHeadroom() const {
+    return (targetFrameTime - smoothedUpdate - smoothedRender) / targetFrameTime;
+}
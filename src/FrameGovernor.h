@@ -0,0 +1,52 @@
+#pragma once
+
+class Simulation;
+
+// Trades simulation/render quality for frame time. Fed with the measured cost
+// of update and render each frame, it steps down a fixed quality ladder when
+// the budget is exceeded and back up once there is sustained headroom.
+class FrameGovernor {
+public:
+    struct QualityLevel {
+        int substeps;
+        bool xsph;
+        int neighborListInterval;   // See Simulation::setNeighborListInterval
+        int renderDecimation;       // Draw every n-th particle
+    };
+
+    static constexpr int LEVEL_COUNT = 5;
+
+    FrameGovernor(double targetFrameTime = 1.0 / 60.0);
+
+    // Record the CPU cost (seconds) of the frame that just finished
+    void recordFrame(double updateSeconds, double renderSeconds);
+    void apply(Simulation& sim) const;
+
+    void setEnabled(bool enabled);
+    bool isEnabled() const { return enabled; }
+
+    int getLevel() const { return level; }
+    const QualityLevel& getQuality() const;
+    // Fraction of the target frame time left over; negative when over budget
+    double getHeadroom() const;
+    double getUpdateTime() const { return smoothedUpdate; }
+    double getRenderTime() const { return smoothedRender; }
+
+private:
+    double targetFrameTime;
+    double budgetFraction = 0.8;      // Leave room for swap and event handling
+    double raiseFraction = 0.5;       // Step up only when well under budget
+    double smoothing = 0.1;           // EMA weight of the newest frame
+
+    double smoothedUpdate = 0.0;
+    double smoothedRender = 0.0;
+    bool hasSample = false;
+
+    int level = LEVEL_COUNT - 1;
+    int cooldown = 0;                 // Frames to let the averages settle
+    int framesUnderBudget = 0;
+    bool enabled = true;
+
+    static constexpr int SETTLE_FRAMES = 20;
+    static constexpr int RAISE_FRAMES = 90;
+};
@@ -0,0 +1,112 @@
+#include "FrameReader.h"
+#include <cstring>
+#include <iostream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+FrameReader::FrameReader() {}
+
+FrameReader::~FrameReader() {
+    close();
+}
+
+bool FrameReader::open(const std::string& name) {
+    close();
+
+    int fd = shm_open(name.c_str(), O_RDONLY, 0);
+    if (fd < 0) return false;
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < sizeof(ExportHeader)) {
+        ::close(fd);
+        return false;
+    }
+
+    size_t bytes = static_cast<size_t>(info.st_size);
+    void* ptr = mmap(nullptr, bytes, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (ptr == MAP_FAILED) return false;
+
+    const ExportHeader* h = static_cast<const ExportHeader*>(ptr);
+    bool valid = std::memcmp(h->magic, EXPORT_MAGIC, sizeof(EXPORT_MAGIC)) == 0;
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (valid && h->version != EXPORT_VERSION) {
+        std::cerr << "ERROR::EXPORT: unsupported layout version " << h->version << std::endl;
+        valid = false;
+    }
+    if (valid && h->headerSize + static_cast<size_t>(h->slotSize) * h->slotCount > bytes) {
+        valid = false;
+    }
+    if (!valid) {
+        munmap(ptr, bytes);
+        return false;
+    }
+
+    header = h;
+    mappedBytes = bytes;
+    return true;
+}
+
+void FrameReader::close() {
+    if (!header) return;
+    munmap(const_cast<ExportHeader*>(header), mappedBytes);
+    header = nullptr;
+    mappedBytes = 0;
+}
+
+const SlotHeader* FrameReader::slot(uint32_t index) const {
+    const char* base = reinterpret_cast<const char*>(header) + header->headerSize;
+    return reinterpret_cast<const SlotHeader*>(base + static_cast<size_t>(index) * header->slotSize);
+}
+
+const ExportField* FrameReader::findField(const char* name) const {
+    if (!header) return nullptr;
+    for (uint32_t f = 0; f < header->fieldCount && f < EXPORT_MAX_FIELDS; f++) {
+        if (std::strncmp(header->fields[f].name, name, sizeof(header->fields[f].name)) == 0) {
+            return &header->fields[f];
+        }
+    }
+    return nullptr;
+}
+
+uint64_t FrameReader::getPublishedFrames() const {
+    return header ? header->publishedFrames.load(std::memory_order_acquire) : 0;
+}
+
+bool FrameReader::acquireLatest(FrameView& view) const {
+    if (!header) return false;
+
+    const ExportField* position = findField("position");
+    const ExportField* velocity = findField("velocity");
+    const ExportField* density = findField("density");
+
+    // Walk back from the newest slot if the writer has already lapped it
+    uint64_t published = getPublishedFrames();
+    for (uint32_t back = 0; back < header->slotCount && back < published; back++) {
+        const SlotHeader* s = slot(static_cast<uint32_t>((published - 1 - back) % header->slotCount));
+        uint64_t seq = s->sequence.load(std::memory_order_acquire);
+        if (seq & 1) continue;
+
+        const char* data = reinterpret_cast<const char*>(s);
+        view.frameIndex = s->frameIndex;
+        view.simTime = s->simTime;
+        view.publishNanos = s->publishNanos;
+        view.count = s->count;
+        view.positions = position ? reinterpret_cast<const float*>(data + position->offset) : nullptr;
+        view.velocities = velocity ? reinterpret_cast<const float*>(data + velocity->offset) : nullptr;
+        view.densities = density ? reinterpret_cast<const float*>(data + density->offset) : nullptr;
+        view.slot = s;
+        view.sequence = seq;
+
+        if (validate(view)) return true;
+    }
+    return false;
+}
+
+bool FrameReader::validate(const FrameView& view) const {
+    if (!view.slot) return false;
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return view.slot->sequence.load(std::memory_order_relaxed) == view.sequence;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <string>
+#include <cstddef>
+#include "FrameExport.h"
+
+// Zero-copy view of one exported frame. The pointers alias the shared
+// segment; call FrameReader::validate after reading to make sure the writer
+// did not reuse the slot meanwhile.
+struct FrameView {
+    uint64_t frameIndex = 0;
+    double simTime = 0.0;
+    uint64_t publishNanos = 0;
+    uint32_t count = 0;
+    const float* positions = nullptr;    // x, y pairs
+    const float* velocities = nullptr;   // x, y pairs
+    const float* densities = nullptr;
+
+    const SlotHeader* slot = nullptr;
+    uint64_t sequence = 0;
+};
+
+// Maps a segment created by FrameExporter read-only. Never blocks the writer.
+class FrameReader {
+public:
+    FrameReader();
+    ~FrameReader();
+
+    FrameReader(const FrameReader&) = delete;
+    FrameReader& operator=(const FrameReader&) = delete;
+
+    bool open(const std::string& name);
+    void close();
+    bool isOpen() const { return header != nullptr; }
+
+    const ExportHeader* getHeader() const { return header; }
+    const ExportField* findField(const char* name) const;
+
+    // Frames published so far (0 until the first frame arrives)
+    uint64_t getPublishedFrames() const;
+
+    // Fills view with the newest stable frame; false if none is available or
+    // the writer is inside every slot we tried
+    bool acquireLatest(FrameView& view) const;
+    // True if the frame in view was not overwritten while it was being read
+    bool validate(const FrameView& view) const;
+
+private:
+    const ExportHeader* header = nullptr;
+    size_t mappedBytes = 0;
+
+    const SlotHeader* slot(uint32_t index) const;
+};
@@ -0,0 +1,151 @@
+#include "Numa.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace numa {
+
+// Large arrays are mapped directly so they start untouched (and can be
+// backed by transparent huge pages); small ones go through malloc.
+static const std::size_t MMAP_THRESHOLD = 64 * 1024;
+static const std::size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+#ifdef __linux__
+
+// Parses a sysfs cpu/node list such as "0-3,8-11"
+static std::vector<int> parseList(const std::string& text) {
+    std::vector<int> values;
+    std::stringstream ss(text);
+    std::string range;
+    while (std::getline(ss, range, ',')) {
+        if (range.empty() || range == "\n") continue;
+        std::size_t dash = range.find('-');
+        int first = std::atoi(range.substr(0, dash).c_str());
+        int last = dash == std::string::npos ? first : std::atoi(range.substr(dash + 1).c_str());
+        for (int v = first; v <= last; v++) values.push_back(v);
+    }
+    return values;
+}
+
+static std::string readFirstLine(const std::string& path) {
+    std::ifstream file(path);
+    std::string line;
+    std::getline(file, line);
+    return line;
+}
+
+int nodeCount() {
+    static const int count = [] {
+        std::vector<int> nodes = parseList(readFirstLine("/sys/devices/system/node/online"));
+        return nodes.empty() ? 1 : nodes.back() + 1;
+    }();
+    return count;
+}
+
+std::vector<int> nodeCpus(int node) {
+    return parseList(readFirstLine("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist"));
+}
+
+bool pinCurrentThreadToNode(int node) {
+    std::vector<int> cpus = nodeCpus(node);
+    if (cpus.empty()) return false;
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu : cpus) CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+}
+
+int currentNode() {
+    static const std::vector<int> cpuToNode = [] {
+        std::vector<int> map;
+        for (int node = 0; node < nodeCount(); node++) {
+            for (int cpu : nodeCpus(node)) {
+                if (cpu >= static_cast<int>(map.size())) map.resize(cpu + 1, 0);
+                map[cpu] = node;
+            }
+        }
+        return map;
+    }();
+    int cpu = sched_getcpu();
+    return cpu >= 0 && cpu < static_cast<int>(cpuToNode.size()) ? cpuToNode[cpu] : 0;
+}
+
+std::vector<int> pageNodes(const void* data, std::size_t bytes) {
+    long pageSize = sysconf(_SC_PAGESIZE);
+    auto first = reinterpret_cast<std::uintptr_t>(data) & ~static_cast<std::uintptr_t>(pageSize - 1);
+    auto last = reinterpret_cast<std::uintptr_t>(data) + bytes;
+
+    std::vector<void*> pages;
+    for (std::uintptr_t p = first; p < last; p += pageSize) {
+        pages.push_back(reinterpret_cast<void*>(p));
+    }
+
+    // move_pages with no target nodes only reports where each page lives
+    std::vector<int> status(pages.size(), -1);
+    if (!pages.empty() &&
+        syscall(SYS_move_pages, 0, pages.size(), pages.data(), nullptr, status.data(), 0) != 0) {
+        std::fill(status.begin(), status.end(), -1);
+    }
+    for (int& s : status) {
+        if (s < 0) s = -1;
+    }
+    return status;
+}
+
+void* allocate(std::size_t bytes, bool hugePages) {
+    if (bytes < MMAP_THRESHOLD) return std::malloc(bytes);
+
+    void* ptr = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (ptr == MAP_FAILED) return nullptr;
+    if (hugePages && bytes >= HUGE_PAGE_SIZE) {
+        madvise(ptr, bytes, MADV_HUGEPAGE);
+    }
+    return ptr;
+}
+
+void deallocate(void* ptr, std::size_t bytes) {
+    if (!ptr) return;
+    if (bytes < MMAP_THRESHOLD) {
+        std::free(ptr);
+    } else {
+        munmap(ptr, bytes);
+    }
+}
+
+#else
+
+int nodeCount() { return 1; }
+
+std::vector<int> nodeCpus(int /*node*/) { return {}; }
+
+bool pinCurrentThreadToNode(int /*node*/) { return false; }
+
+int currentNode() { return 0; }
+
+std::vector<int> pageNodes(const void* /*data*/, std::size_t /*bytes*/) { return {}; }
+
+void* allocate(std::size_t bytes, bool /*hugePages*/) {
+    (void)MMAP_THRESHOLD;
+    (void)HUGE_PAGE_SIZE;
+    return std::malloc(bytes);
+}
+
+void deallocate(void* ptr, std::size_t /*bytes*/) {
+    std::free(ptr);
+}
+
+#endif
+
+} // namespace numa
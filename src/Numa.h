@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstddef>
+#include <new>
+#include <utility>
+#include <vector>
+
+// NUMA topology, thread pinning and page placement helpers. On systems
+// without NUMA support (macOS, single-node Linux) everything reports a
+// single node and pinning is a no-op.
+namespace numa {
+
+int nodeCount();
+std::vector<int> nodeCpus(int node);
+bool pinCurrentThreadToNode(int node);
+int currentNode();
+
+// Node holding each page of [data, data + bytes); -1 for unknown pages
+std::vector<int> pageNodes(const void* data, std::size_t bytes);
+
+void* allocate(std::size_t bytes, bool hugePages);
+void deallocate(void* ptr, std::size_t bytes);
+
+} // namespace numa
+
+// Allocator that maps memory without touching it, so pages are placed on the
+// node of the thread that first writes them. Default construction leaves
+// trivially constructible elements uninitialized for the same reason.
+template <typename T>
+class NumaAllocator {
+public:
+    using value_type = T;
+    using propagate_on_container_copy_assignment = std::true_type;
+    using propagate_on_container_move_assignment = std::true_type;
+    using propagate_on_container_swap = std::true_type;
+
+    NumaAllocator(bool hugePages = false) : hugePages(hugePages) {}
+    template <typename U>
+    NumaAllocator(const NumaAllocator<U>& other) : hugePages(other.usesHugePages()) {}
+
+    T* allocate(std::size_t n) {
+        void* ptr = numa::allocate(n * sizeof(T), hugePages);
+        if (!ptr) throw std::bad_alloc();
+        return static_cast<T*>(ptr);
+    }
+
+    void deallocate(T* ptr, std::size_t n) {
+        numa::deallocate(ptr, n * sizeof(T));
+    }
+
+    template <typename U>
+    void construct(U* ptr) {
+        ::new (static_cast<void*>(ptr)) U;
+    }
+
+    template <typename U, typename... Args>
+    void construct(U* ptr, Args&&... args) {
+        ::new (static_cast<void*>(ptr)) U(std::forward<Args>(args)...);
+    }
+
+    bool usesHugePages() const { return hugePages; }
+
+    template <typename U>
+    bool operator==(const NumaAllocator<U>& other) const { return hugePages == other.usesHugePages(); }
+    template <typename U>
+    bool operator!=(const NumaAllocator<U>& other) const { return !(*this == other); }
+
+private:
+    bool hugePages;
+};
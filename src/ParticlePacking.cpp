@@ -0,0 +1,115 @@
+#include "ParticlePacking.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+// Result is a normal half: rebias the exponent and round the dropped 13
+// mantissa bits to nearest even in one add
+static inline uint32_t normalHalfBits(uint32_t magnitude) {
+    return (magnitude - 0x38000000u + 0x0fffu + ((magnitude >> 13) & 1u)) >> 13;
+}
+
+// Inlined packing path; zero and normal halfs (all velocities and
+// densities in practice) never leave it
+static inline uint16_t packHalf(float value) {
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    uint32_t magnitude = bits & 0x7fffffffu;
+    if (magnitude - 0x38800000u < 0x477ff000u - 0x38800000u) {
+        return static_cast<uint16_t>(((bits >> 16) & 0x8000u) | normalHalfBits(magnitude));
+    }
+    if (magnitude == 0) return static_cast<uint16_t>((bits >> 16) & 0x8000u);
+    return floatToHalf(value);
+}
+
+// Round-to-nearest-even conversion; overflow saturates to infinity and
+// values below the half subnormal range flush to signed zero
+uint16_t floatToHalf(float value) {
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+
+    uint32_t sign = (bits >> 16) & 0x8000u;
+    uint32_t magnitude = bits & 0x7fffffffu;
+
+    if (magnitude >= 0x38800000u && magnitude < 0x477ff000u) {
+        return static_cast<uint16_t>(sign | normalHalfBits(magnitude));
+    }
+
+    if (magnitude >= 0x7f800000u) {
+        // Inf stays inf, NaN stays a quiet NaN
+        return static_cast<uint16_t>(sign | 0x7c00u | (magnitude > 0x7f800000u ? 0x200u : 0u));
+    }
+    if (magnitude >= 0x477ff000u) {
+        // Rounds above the largest half (65504)
+        return static_cast<uint16_t>(sign | 0x7c00u);
+    }
+    if (magnitude < 0x33000001u) {
+        return static_cast<uint16_t>(sign);
+    }
+
+    int exponent = static_cast<int>(magnitude >> 23);
+    uint32_t mantissa = (magnitude & 0x7fffffu) | 0x800000u;
+    if (exponent < 113) {
+        // Subnormal half: shift the implicit-one mantissa into place
+        int shift = 126 - exponent;
+        uint32_t half = mantissa >> shift;
+        uint32_t remainder = mantissa & ((1u << shift) - 1u);
+        uint32_t halfway = 1u << (shift - 1);
+        if (remainder > halfway || (remainder == halfway && (half & 1u))) half++;
+        return static_cast<uint16_t>(sign | half);
+    }
+
+    uint32_t half = (static_cast<uint32_t>(exponent - 112) << 10) | ((mantissa >> 13) & 0x3ffu);
+    uint32_t remainder = mantissa & 0x1fffu;
+    if (remainder > 0x1000u || (remainder == 0x1000u && (half & 1u))) half++;
+    return static_cast<uint16_t>(sign | half);
+}
+
+float halfToFloat(uint16_t half) {
+    uint32_t sign = static_cast<uint32_t>(half & 0x8000u) << 16;
+    uint32_t exponent = (half >> 10) & 0x1fu;
+    uint32_t mantissa = half & 0x3ffu;
+
+    uint32_t bits;
+    if (exponent == 0x1fu) {
+        bits = sign | 0x7f800000u | (mantissa << 13);
+    } else if (exponent != 0) {
+        bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+    } else if (mantissa == 0) {
+        bits = sign;
+    } else {
+        // Normalize a subnormal half
+        exponent = 113;
+        while (!(mantissa & 0x400u)) {
+            mantissa <<= 1;
+            exponent--;
+        }
+        bits = sign | (exponent << 23) | ((mantissa & 0x3ffu) << 13);
+    }
+
+    float value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+static uint16_t toUnorm16(float value) {
+    return static_cast<uint16_t>(std::min(std::max(value, 0.0f), 1.0f) * 65535.0f + 0.5f);
+}
+
+void packParticles(const ParticleArray& particles, int decimation, const glm::vec2& domainMin,
+                   const glm::vec2& domainSize, float baseMass, PackedParticle* out, int count) {
+    glm::vec2 invSize(1.0f / domainSize.x, 1.0f / domainSize.y);
+    float invBaseMass = 1.0f / baseMass;
+    for (int k = 0; k < count; k++) {
+        const Particle& p = particles[static_cast<size_t>(k) * decimation];
+        PackedParticle packed;
+        packed.position[0] = toUnorm16((p.position.x - domainMin.x) * invSize.x);
+        packed.position[1] = toUnorm16((p.position.y - domainMin.y) * invSize.y);
+        packed.velocity[0] = packHalf(p.velocity.x);
+        packed.velocity[1] = packHalf(p.velocity.y);
+        packed.density = packHalf(p.density);
+        packed.size = packHalf(std::sqrt(p.mass * invBaseMass));
+        // Whole-struct store: mapped GPU memory is often write-combined
+        out[k] = packed;
+    }
+}
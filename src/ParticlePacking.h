@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstdint>
+#include "Simulation.h"
+
+// Compact per-particle vertex layout for streaming to the GPU (12 bytes vs.
+// 24 for six floats). particle.vert decodes it:
+//   position: unsigned 16-bit normalized over the domain (GL_UNSIGNED_SHORT,
+//             normalized), mapped back with positionOffset/positionScale
+//   velocity, density: IEEE half floats (GL_HALF_FLOAT)
+//   size: half float point size factor, sqrt(mass / base mass)
+struct PackedParticle {
+    uint16_t position[2];
+    uint16_t velocity[2];
+    uint16_t density;
+    uint16_t size;
+};
+
+static_assert(sizeof(PackedParticle) == 12, "PackedParticle must match the vertex layout");
+
+uint16_t floatToHalf(float value);
+float halfToFloat(uint16_t half);
+
+// Writes every decimation-th particle into out[0 .. count); positions are
+// normalized over [domainMin, domainMin + domainSize]
+void packParticles(const ParticleArray& particles, int decimation, const glm::vec2& domainMin,
+                   const glm::vec2& domainSize, float baseMass, PackedParticle* out, int count);
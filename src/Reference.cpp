@@ -0,0 +1,146 @@
+#include "Reference.h"
+#include <algorithm>
+#include <cmath>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+namespace reference {
+
+struct Kernels {
+    double h, h2;
+    double poly6Coeff, spikyGradCoeff, viscLaplCoeff;
+
+    explicit Kernels(double smoothingRadius) {
+        h = smoothingRadius;
+        h2 = h * h;
+        poly6Coeff = 4.0 / (M_PI * std::pow(h, 8.0));
+        spikyGradCoeff = -10.0 / (M_PI * std::pow(h, 5.0));
+        viscLaplCoeff = 40.0 / (M_PI * std::pow(h, 5.0));
+    }
+};
+
+static std::vector<Kernels> makeKernels(const Params& params, size_t n) {
+    std::vector<Kernels> kernels;
+    kernels.reserve(n);
+    for (size_t i = 0; i < n; i++) {
+        kernels.emplace_back(params.smoothingLengths.empty() ? params.smoothingRadius
+                                                             : params.smoothingLengths[i]);
+    }
+    return kernels;
+}
+
+static double massOf(const Params& params, size_t i) {
+    return params.masses.empty() ? params.particleMass : params.masses[i];
+}
+
+void computeDensityPressure(const Params& params, const std::vector<Vec2d>& positions,
+                            std::vector<double>& density, std::vector<double>& pressure) {
+    size_t n = positions.size();
+    std::vector<Kernels> kernels = makeKernels(params, n);
+    density.assign(n, 0.0);
+    pressure.assign(n, 0.0);
+
+    for (size_t i = 0; i < n; i++) {
+        const Kernels& k = kernels[i];
+        double rho = 0.0;
+        for (size_t j = 0; j < n; j++) {
+            double dx = positions[i].x - positions[j].x;
+            double dy = positions[i].y - positions[j].y;
+            double r2 = dx * dx + dy * dy;
+            if (r2 < k.h2) {
+                double d = k.h2 - r2;
+                rho += massOf(params, j) * k.poly6Coeff * d * d * d;
+            }
+        }
+
+        rho = std::max(rho, params.restDensity * 0.1);
+        double ratio = rho / params.restDensity;
+        density[i] = rho;
+        pressure[i] = params.gasConstant * (std::pow(ratio, 7.0) - 1.0);
+    }
+}
+
+void computeForces(const Params& params, const std::vector<Vec2d>& positions,
+                   const std::vector<Vec2d>& velocities, const std::vector<double>& density,
+                   const std::vector<double>& pressure, std::vector<Vec2d>& forces) {
+    size_t n = positions.size();
+    std::vector<Kernels> kernels = makeKernels(params, n);
+    forces.assign(n, Vec2d());
+
+    for (size_t i = 0; i < n; i++) {
+        const Kernels& ki = kernels[i];
+        Vec2d f;
+        for (size_t j = 0; j < n; j++) {
+            if (i == j) continue;
+
+            const Kernels& kj = kernels[j];
+            double dx = positions[i].x - positions[j].x;
+            double dy = positions[i].y - positions[j].y;
+            double r2 = dx * dx + dy * dy;
+            if ((r2 >= ki.h2 && r2 >= kj.h2) || r2 <= 1e-12) continue;
+
+            double r = std::sqrt(r2);
+            double spiky = 0.0, lapl = 0.0;
+            for (const Kernels* k : { &ki, &kj }) {
+                if (r2 >= k->h2) continue;
+                double q = k->h - r;
+                spiky += 0.5 * k->spikyGradCoeff * q * q;
+                lapl += 0.5 * k->viscLaplCoeff * q;
+            }
+
+            // Pressure (Spiky gradient) along the unit separation
+            double pressureForce = -massOf(params, j) * (pressure[i] + pressure[j]) /
+                                   (2.0 * density[j]) * spiky;
+            f.x += pressureForce * dx / r;
+            f.y += pressureForce * dy / r;
+
+            // Viscosity (Laplacian)
+            double viscForce = params.viscosity * massOf(params, j) / density[j] * lapl;
+            f.x += viscForce * (velocities[j].x - velocities[i].x);
+            f.y += viscForce * (velocities[j].y - velocities[i].y);
+        }
+
+        f.x += params.gravity.x * density[i];
+        f.y += params.gravity.y * density[i];
+        forces[i] = f;
+    }
+}
+
+void computeXSPHVelocities(const Params& params, const std::vector<Vec2d>& positions,
+                           const std::vector<Vec2d>& velocities, const std::vector<double>& density,
+                           std::vector<Vec2d>& smoothed) {
+    size_t n = positions.size();
+    std::vector<Kernels> kernels = makeKernels(params, n);
+    smoothed.assign(n, Vec2d());
+
+    for (size_t i = 0; i < n; i++) {
+        const Kernels& ki = kernels[i];
+        Vec2d c;
+        for (size_t j = 0; j < n; j++) {
+            if (i == j) continue;
+
+            const Kernels& kj = kernels[j];
+            double dx = positions[i].x - positions[j].x;
+            double dy = positions[i].y - positions[j].y;
+            double r2 = dx * dx + dy * dy;
+            if ((r2 >= ki.h2 && r2 >= kj.h2) || r2 <= 1e-12) continue;
+
+            double w = 0.0;
+            for (const Kernels* k : { &ki, &kj }) {
+                if (r2 >= k->h2) continue;
+                double d = k->h2 - r2;
+                w += 0.5 * k->poly6Coeff * d * d * d;
+            }
+            double weight = w * massOf(params, j) / density[j];
+            c.x += (velocities[j].x - velocities[i].x) * weight;
+            c.y += (velocities[j].y - velocities[i].y) * weight;
+        }
+
+        smoothed[i].x = velocities[i].x + params.xsphEpsilon * c.x;
+        smoothed[i].y = velocities[i].y + params.xsphEpsilon * c.y;
+    }
+}
+
+} // namespace reference
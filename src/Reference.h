@@ -0,0 +1,45 @@
+#pragma once
+
+#include <vector>
+
+// Brute-force O(N^2) double-precision SPH used as an oracle for the
+// production phases. Every function mirrors the corresponding
+// Simulation::compute* phase term for term, but visits all pairs and
+// accumulates in double so grid, list, threading or precision changes in
+// the production path show up as deviations.
+namespace reference {
+
+struct Vec2d {
+    double x = 0.0, y = 0.0;
+};
+
+struct Params {
+    double smoothingRadius;
+    double restDensity;
+    double gasConstant;
+    double viscosity;
+    double particleMass;
+    double xsphEpsilon;
+    Vec2d gravity;
+    // Per-particle h for adaptive smoothing; empty means smoothingRadius for
+    // all. Density gathers over h_i, pair terms average the kernels of h_i and h_j
+    std::vector<double> smoothingLengths;
+    // Per-particle mass (adaptive resolution); empty means particleMass for all
+    std::vector<double> masses;
+};
+
+// density[i], pressure[i] from positions
+void computeDensityPressure(const Params& params, const std::vector<Vec2d>& positions,
+                            std::vector<double>& density, std::vector<double>& pressure);
+
+// force[i] from positions, velocities and the given density/pressure
+void computeForces(const Params& params, const std::vector<Vec2d>& positions,
+                   const std::vector<Vec2d>& velocities, const std::vector<double>& density,
+                   const std::vector<double>& pressure, std::vector<Vec2d>& forces);
+
+// XSPH-smoothed velocities (velocity + epsilon * correction)
+void computeXSPHVelocities(const Params& params, const std::vector<Vec2d>& positions,
+                           const std::vector<Vec2d>& velocities, const std::vector<double>& density,
+                           std::vector<Vec2d>& smoothed);
+
+} // namespace reference
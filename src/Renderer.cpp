@@ -1,7 +1,14 @@
 #include "Renderer.h"
+#include "ParticlePacking.h"
+#include "DensityField.h"
+#include "Tracer.h"
+#include "View.h"
 #include <glm/gtc/matrix_transform.hpp>
+#include <algorithm>
+#include <cstddef>
 #include <iostream>
 #include <vector>
+#include <cmath>
 
 Renderer::Renderer() {}
 
@@ -10,8 +17,15 @@ Renderer::~Renderer() {
     if (particleVBO) glDeleteBuffers(1, &particleVBO);
     if (boxVAO) glDeleteVertexArrays(1, &boxVAO);
     if (boxVBO) glDeleteBuffers(1, &boxVBO);
+    if (surfaceVAO) glDeleteVertexArrays(1, &surfaceVAO);
+    if (surfaceVBO) glDeleteBuffers(1, &surfaceVBO);
     if (bgVAO) glDeleteVertexArrays(1, &bgVAO);
     if (bgVBO) glDeleteBuffers(1, &bgVBO);
+    for (auto& slot : streamSlots) {
+        if (slot.fence) glDeleteSync(slot.fence);
+        if (slot.vao) glDeleteVertexArrays(1, &slot.vao);
+        if (slot.vbo) glDeleteBuffers(1, &slot.vbo);
+    }
 }
 
 void Renderer::setupParticleBuffers() {
@@ -21,8 +35,8 @@ void Renderer::setupParticleBuffers() {
     glBindVertexArray(particleVAO);
     glBindBuffer(GL_ARRAY_BUFFER, particleVBO);
     
-    // Position (vec2) + Velocity (vec2) + Density (float) = 5 floats per particle
-    size_t stride = 5 * sizeof(float);
+    // Position (vec2) + Velocity (vec2) + Density (float) + Size (float) = 6 floats per particle
+    size_t stride = 6 * sizeof(float);
     
     // Position
     glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, stride, (void*)0);
@@ -36,30 +50,47 @@ void Renderer::setupParticleBuffers() {
     glVertexAttribPointer(2, 1, GL_FLOAT, GL_FALSE, stride, (void*)(4 * sizeof(float)));
     glEnableVertexAttribArray(2);
     
+    // Size
+    glVertexAttribPointer(3, 1, GL_FLOAT, GL_FALSE, stride, (void*)(5 * sizeof(float)));
+    glEnableVertexAttribArray(3);
+    
+    glBindVertexArray(0);
+}
+
+void Renderer::setupStreamBuffers() {
+    for (auto& slot : streamSlots) {
+        glGenVertexArrays(1, &slot.vao);
+        glGenBuffers(1, &slot.vbo);
+
+        glBindVertexArray(slot.vao);
+        glBindBuffer(GL_ARRAY_BUFFER, slot.vbo);
+
+        // Packed layout: unorm16 position, half velocity, density and size
+        GLsizei stride = sizeof(PackedParticle);
+        glVertexAttribPointer(0, 2, GL_UNSIGNED_SHORT, GL_TRUE, stride,
+                              (void*)offsetof(PackedParticle, position));
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(1, 2, GL_HALF_FLOAT, GL_FALSE, stride,
+                              (void*)offsetof(PackedParticle, velocity));
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(2, 1, GL_HALF_FLOAT, GL_FALSE, stride,
+                              (void*)offsetof(PackedParticle, density));
+        glEnableVertexAttribArray(2);
+        glVertexAttribPointer(3, 1, GL_HALF_FLOAT, GL_FALSE, stride,
+                              (void*)offsetof(PackedParticle, size));
+        glEnableVertexAttribArray(3);
+    }
     glBindVertexArray(0);
 }
 
 void Renderer::setupBoxBuffers() {
-    float min = Simulation::DOMAIN_MIN;
-    float max = Simulation::DOMAIN_MAX;
-    
-    float boxVertices[] = {
-        min, min,
-        max, min,
-        max, min,
-        max, max,
-        max, max,
-        min, max,
-        min, max,
-        min, min
-    };
-    
+    // Domain walls, re-uploaded every frame: open sides follow the view
     glGenVertexArrays(1, &boxVAO);
     glGenBuffers(1, &boxVBO);
     
     glBindVertexArray(boxVAO);
     glBindBuffer(GL_ARRAY_BUFFER, boxVBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(boxVertices), boxVertices, GL_STATIC_DRAW);
+    glBufferData(GL_ARRAY_BUFFER, 4 * sizeof(glm::vec4), nullptr, GL_DYNAMIC_DRAW);
     
     glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
     glEnableVertexAttribArray(0);
@@ -67,6 +98,20 @@ void Renderer::setupBoxBuffers() {
     glBindVertexArray(0);
 }
 
+void Renderer::setupSurfaceBuffers() {
+    glGenVertexArrays(1, &surfaceVAO);
+    glGenBuffers(1, &surfaceVBO);
+    
+    glBindVertexArray(surfaceVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, surfaceVBO);
+    
+    // SurfaceSegment is two packed vec2 endpoints
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(0);
+    
+    glBindVertexArray(0);
+}
+
 void Renderer::setupBackground() {
     // Full-screen quad in NDC
     float bgVertices[] = {
@@ -182,7 +227,9 @@ bool Renderer::init(const std::string& shaderDir) {
     glDeleteShader(bgfs);
     
     setupParticleBuffers();
+    setupStreamBuffers();
     setupBoxBuffers();
+    setupSurfaceBuffers();
     setupBackground();
     
     // Enable point sprites
@@ -192,6 +239,16 @@ bool Renderer::init(const std::string& shaderDir) {
 }
 
 void Renderer::render(const Simulation& sim, int windowWidth, int windowHeight) {
+    trace::Scope renderScope("render", "render");
+    // Fence last frame's stream slot now rather than right after its draw:
+    // creating a fence flushes, and mid-frame that splits the scene (a
+    // tiled or software rasterizer then renders it twice). After the swap
+    // the flush is free and the fence still covers the draw.
+    if (fencePending) {
+        fencePending->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        fencePending = nullptr;
+    }
+
     glViewport(0, 0, windowWidth, windowHeight);
     
     // Draw background
@@ -200,22 +257,10 @@ void Renderer::render(const Simulation& sim, int windowWidth, int windowHeight)
     glBindVertexArray(bgVAO);
     glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
     
-    // Compute projection that maps [0,1]x[0,1] to clip space with some padding
-    float aspect = static_cast<float>(windowWidth) / static_cast<float>(windowHeight);
-    float padding = 0.05f;
-    
-    glm::mat4 projection;
-    if (aspect >= 1.0f) {
-        float halfW = (0.5f + padding) * aspect;
-        float halfH = 0.5f + padding;
-        projection = glm::ortho(0.5f - halfW, 0.5f + halfW, 
-                                0.5f - halfH, 0.5f + halfH);
-    } else {
-        float halfW = 0.5f + padding;
-        float halfH = (0.5f + padding) / aspect;
-        projection = glm::ortho(0.5f - halfW, 0.5f + halfW, 
-                                0.5f - halfH, 0.5f + halfH);
-    }
+    // Compute projection that maps the view bounds to clip space with some padding
+    View view = fitView(sim, windowWidth, windowHeight);
+    glm::mat4 projection = glm::ortho(view.center.x - view.halfExtent.x, view.center.x + view.halfExtent.x,
+                                      view.center.y - view.halfExtent.y, view.center.y + view.halfExtent.y);
     
     // Enable blending for particles
     glEnable(GL_BLEND);
@@ -226,40 +271,134 @@ void Renderer::render(const Simulation& sim, int windowWidth, int windowHeight)
     lineShader.setMat4("projection", projection);
     lineShader.setVec3("lineColor", glm::vec3(0.15f, 0.35f, 0.65f));
     
+    glm::vec4 walls[4];
+    int wallCount = domainWalls(sim, view, walls);
     glBindVertexArray(boxVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, boxVBO);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, wallCount * sizeof(glm::vec4), walls);
     glLineWidth(2.0f);
-    glDrawArrays(GL_LINES, 0, 8);
+    glDrawArrays(GL_LINES, 0, wallCount * 2);
     
     // Upload particle data
-    const auto& particles = sim.getParticles();
-    int count = sim.getParticleCount();
-    
-    std::vector<float> data(count * 5);
-    for (int i = 0; i < count; i++) {
-        data[i * 5 + 0] = particles[i].position.x;
-        data[i * 5 + 1] = particles[i].position.y;
-        data[i * 5 + 2] = particles[i].velocity.x;
-        data[i * 5 + 3] = particles[i].velocity.y;
-        data[i * 5 + 4] = particles[i].density;
+    int count = (sim.getParticleCount() + decimation - 1) / decimation;
+    glm::vec2 positionOffset(0.0f);
+    glm::vec2 positionScale(1.0f);
+    StreamSlot* slot = nullptr;
+
+    if (streamingUpload) {
+        trace::Scope scope("upload stream", "render");
+        slot = &streamSlots[streamIndex];
+        streamIndex = (streamIndex + 1) % STREAM_SLOTS;
+        // Positions are normalized over the view bounds, which hold the fluid
+        glm::vec2 boundsMin, boundsMax;
+        sim.getViewBounds(boundsMin, boundsMax);
+        if (uploadStreaming(sim, count, boundsMin, boundsMax - boundsMin, *slot)) {
+            glBindVertexArray(slot->vao);
+            positionOffset = boundsMin;
+            positionScale = boundsMax - boundsMin;
+        } else {
+            slot = nullptr;
+            uploadFloat(sim, count);
+        }
+    } else {
+        trace::Scope scope("upload float", "render");
+        uploadFloat(sim, count);
     }
     
-    glBindVertexArray(particleVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, particleVBO);
-    glBufferData(GL_ARRAY_BUFFER, data.size() * sizeof(float), data.data(), GL_DYNAMIC_DRAW);
-    
     // Draw particles with additive blending for glow effect
+    trace::Scope drawScope("draw", "render");
     glBlendFunc(GL_SRC_ALPHA, GL_ONE);
     
     particleShader.use();
     particleShader.setMat4("projection", projection);
+    particleShader.setVec2("positionOffset", positionOffset);
+    particleShader.setVec2("positionScale", positionScale);
     
     // Point size relative to window
     float pointSize = std::max(4.0f, static_cast<float>(windowHeight) * 0.012f);
+    pointSize *= std::sqrt(static_cast<float>(decimation));
     particleShader.setFloat("pointSize", pointSize);
     
     glDrawArrays(GL_POINTS, 0, count);
+
+    // Fenced on the next frame (see above)
+    fencePending = slot;
     
     // Reset blend mode
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    
+    // Free surface on top
+    if (surface && !surface->getSegments().empty()) {
+        const auto& segments = surface->getSegments();
+        glBindVertexArray(surfaceVAO);
+        glBindBuffer(GL_ARRAY_BUFFER, surfaceVBO);
+        glBufferData(GL_ARRAY_BUFFER, segments.size() * sizeof(SurfaceSegment), segments.data(), GL_STREAM_DRAW);
+        
+        lineShader.use();
+        lineShader.setVec3("lineColor", glm::vec3(0.75f, 0.9f, 1.0f));
+        glLineWidth(2.0f);
+        glDrawArrays(GL_LINES, 0, static_cast<GLsizei>(segments.size() * 2));
+    }
     glDisable(GL_BLEND);
 }
+
+void Renderer::uploadFloat(const Simulation& sim, int count) {
+    const auto& particles = sim.getParticles();
+
+    float invBaseMass = 1.0f / sim.getParticleMass();
+
+    std::vector<float> data(count * 6);
+    for (int k = 0; k < count; k++) {
+        int i = k * decimation;
+        data[k * 6 + 0] = particles[i].position.x;
+        data[k * 6 + 1] = particles[i].position.y;
+        data[k * 6 + 2] = particles[i].velocity.x;
+        data[k * 6 + 3] = particles[i].velocity.y;
+        data[k * 6 + 4] = particles[i].density;
+        data[k * 6 + 5] = std::sqrt(particles[i].mass * invBaseMass);
+    }
+    
+    glBindVertexArray(particleVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, particleVBO);
+    glBufferData(GL_ARRAY_BUFFER, data.size() * sizeof(float), data.data(), GL_DYNAMIC_DRAW);
+}
+
+bool Renderer::uploadStreaming(const Simulation& sim, int count, const glm::vec2& boundsMin,
+                               const glm::vec2& boundsSize, StreamSlot& slot) {
+    // Normally signaled long ago: the slot was last drawn STREAM_SLOTS frames back
+    if (slot.fence) {
+        glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000ull);
+        glDeleteSync(slot.fence);
+        slot.fence = nullptr;
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, slot.vbo);
+    size_t bytes = static_cast<size_t>(count) * sizeof(PackedParticle);
+    if (bytes > slot.capacity) {
+        // Grow with headroom so particle count changes rarely reallocate
+        slot.capacity = std::max(bytes + bytes / 2, static_cast<size_t>(4096));
+        glBufferData(GL_ARRAY_BUFFER, slot.capacity, nullptr, GL_STREAM_DRAW);
+    }
+    if (bytes == 0) return true;
+
+    // The fence already guarantees the GPU is done with this storage, so map
+    // it without synchronization. No invalidate: orphaning would hand back
+    // fresh storage (and fresh page faults) every frame.
+    void* ptr = glMapBufferRange(GL_ARRAY_BUFFER, 0, bytes,
+        GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+    if (!ptr) {
+        std::cerr << "ERROR::RENDERER: glMapBufferRange failed, using float upload" << std::endl;
+        streamingUpload = false;
+        return false;
+    }
+
+    packParticles(sim.getParticles(), decimation, boundsMin, boundsSize,
+                  sim.getParticleMass(), static_cast<PackedParticle*>(ptr), count);
+
+    if (glUnmapBuffer(GL_ARRAY_BUFFER) != GL_TRUE) {
+        // Storage was lost (e.g. display change); contents are undefined
+        // for this frame only
+        std::cerr << "ERROR::RENDERER: Stream buffer contents lost" << std::endl;
+    }
+    return true;
+}
@@ -5,6 +5,8 @@
 #include "Simulation.h"
 #include <glm/glm.hpp>
 
+class DensityField;
+
 class Renderer {
 public:
     Renderer();
@@ -13,24 +15,62 @@ public:
     bool init(const std::string& shaderDir);
     void render(const Simulation& sim, int windowWidth, int windowHeight);
     
+    // Draw only every n-th particle (enlarged to keep coverage)
+    void setDecimation(int n) { decimation = n > 1 ? n : 1; }
+
+    // Streaming (default): particles are packed straight into a ring of
+    // fenced, mapped buffers. Off: repack into floats and glBufferData.
+    void setStreamingUpload(bool enabled) { streamingUpload = enabled; }
+    bool isStreamingUpload() const { return streamingUpload; }
+
+    // Free-surface contours drawn over the particles. Not owned; nullptr
+    // (the default) hides them. The field is updated by the caller.
+    void setSurface(const DensityField* field) { surface = field; }
+    
 private:
     Shader particleShader;
     Shader lineShader;
     
-    // Particle rendering
+    // Particle rendering (float upload path)
     GLuint particleVAO = 0;
     GLuint particleVBO = 0;
+
+    // Streaming upload ring: a slot is rewritten only once the fence placed
+    // after its last draw has signaled, so mapping it never stalls the GPU
+    static constexpr int STREAM_SLOTS = 3;
+    struct StreamSlot {
+        GLuint vao = 0;
+        GLuint vbo = 0;
+        GLsync fence = nullptr;
+        size_t capacity = 0;    // Bytes allocated for vbo
+    };
+    StreamSlot streamSlots[STREAM_SLOTS];
+    int streamIndex = 0;
+    StreamSlot* fencePending = nullptr;   // Drawn last frame, not fenced yet
+    bool streamingUpload = true;
     
-    // Box rendering
+    // Domain wall rendering
     GLuint boxVAO = 0;
     GLuint boxVBO = 0;
+
+    // Surface contours (GL_LINES, re-uploaded every frame)
+    GLuint surfaceVAO = 0;
+    GLuint surfaceVBO = 0;
+    const DensityField* surface = nullptr;
     
     // Background rendering
     GLuint bgVAO = 0;
     GLuint bgVBO = 0;
     Shader bgShader;
     
+    int decimation = 1;
+    
     void setupParticleBuffers();
+    void setupStreamBuffers();
+    void uploadFloat(const Simulation& sim, int count);
+    bool uploadStreaming(const Simulation& sim, int count, const glm::vec2& boundsMin,
+                         const glm::vec2& boundsSize, StreamSlot& slot);
     void setupBoxBuffers();
+    void setupSurfaceBuffers();
     void setupBackground();
 };
@@ -70,6 +70,10 @@ void Shader::setMat4(const std::string& name, const glm::mat4& mat) const {
     glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
 }
 
+void Shader::setVec2(const std::string& name, const glm::vec2& vec) const {
+    glUniform2f(glGetUniformLocation(ID, name.c_str()), vec.x, vec.y);
+}
+
 void Shader::setVec3(const std::string& name, const glm::vec3& vec) const {
     glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &vec[0]);
 }
@@ -14,6 +14,7 @@ public:
     
     void use() const;
     void setMat4(const std::string& name, const glm::mat4& mat) const;
+    void setVec2(const std::string& name, const glm::vec2& vec) const;
     void setVec3(const std::string& name, const glm::vec3& vec) const;
     void setFloat(const std::string& name, float value) const;
     
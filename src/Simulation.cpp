@@ -1,30 +1,62 @@
 #include "Simulation.h"
+#include "Tracer.h"
 #include <cmath>
 #include <random>
 #include <algorithm>
+#include <limits>
 
 #ifndef M_PI
 #define M_PI 3.14159265358979323846
 #endif
 
-Simulation::Simulation(int numParticles) {
-    // Precompute kernel coefficients
-    float h = smoothingRadius;
-    poly6Coeff = 4.0f / (static_cast<float>(M_PI) * std::pow(h, 8.0f));
-    spikyGradCoeff = -10.0f / (static_cast<float>(M_PI) * std::pow(h, 5.0f));
-    viscLaplCoeff = 40.0f / (static_cast<float>(M_PI) * std::pow(h, 5.0f));
+Simulation::Simulation(int numParticles)
+    : pool(std::make_unique<ThreadPool>(0, false, "sim worker")) {
+    updateKernelCoefficients();
     
     // Compute particle mass from rest density
     // Approximate: mass = restDensity * volume / numParticles
     float volume = (DOMAIN_MAX - DOMAIN_MIN) * (DOMAIN_MAX - DOMAIN_MIN);
     particleMass = restDensity * volume / static_cast<float>(numParticles);
+    baseParticleCount = numParticles;
     
-    particles.resize(numParticles);
     reset();
 }
 
+Simulation::~Simulation() = default;
+
+void Simulation::updateKernelCoefficients() {
+    // Precompute kernel coefficients
+    float h = smoothingRadius;
+    poly6Coeff = 4.0f / (static_cast<float>(M_PI) * std::pow(h, 8.0f));
+    spikyGradCoeff = -10.0f / (static_cast<float>(M_PI) * std::pow(h, 5.0f));
+    viscLaplCoeff = 40.0f / (static_cast<float>(M_PI) * std::pow(h, 5.0f));
+}
+
+void Simulation::setSmoothingRadius(float h) {
+    if (h <= 0.0f) return;
+    smoothingRadius = h;
+    updateKernelCoefficients();
+    for (auto& p : particles) {
+        p.smoothingLength = h;
+    }
+    // Cell size follows h, so cached lists are stale
+    neighborListAge = 0;
+}
+
+void Simulation::setAdaptiveSmoothing(bool enabled) {
+    adaptiveSmoothing = enabled;
+    if (!enabled) adaptiveResolution = false;
+    // Adaptive lengths start from (and fixed ones return to) the global h
+    for (auto& p : particles) {
+        p.smoothingLength = smoothingRadius;
+    }
+    neighborListAge = 0;
+}
+
 void Simulation::reset() {
-    int n = static_cast<int>(particles.size());
+    // Adaptive resolution may have changed the count; start from base mass
+    particles.resize(baseParticleCount);
+    int n = baseParticleCount;
     int cols = static_cast<int>(std::ceil(std::sqrt(static_cast<float>(n) * 0.8f)));
     int rows = (n + cols - 1) / cols;
     
@@ -34,6 +66,10 @@ void Simulation::reset() {
     float spacingX = 0.7f / static_cast<float>(cols);
     float spacingY = 0.5f / static_cast<float>(rows);
     
+    // Place pages on the node of the worker that owns each slice before the
+    // (sequential, seeded) layout pass writes them
+    firstTouchParticles();
+    
     // Small jitter for natural initialization
     std::mt19937 rng(42);
     std::uniform_real_distribution<float> jitter(-0.002f, 0.002f);
@@ -50,7 +86,94 @@ void Simulation::reset() {
         particles[i].force = glm::vec2(0.0f);
         particles[i].density = restDensity;
         particles[i].pressure = 0.0f;
+        particles[i].timeBin = 0;
+        particles[i].smoothingLength = smoothingRadius;
+        particles[i].mass = particleMass;
+    }
+    disturbances.clear();
+    neighborListAge = 0;
+    sortAge = 0;
+    simTime = 0.0;
+    frameIndex = 0;
+    updateTimeBinHistogram();
+}
+
+void Simulation::firstTouchParticles() {
+    pool->run(static_cast<int>(particles.size()), [&](int, int begin, int end) {
+        for (int i = begin; i < end; i++) {
+            particles[i] = Particle{};
+        }
+    });
+}
+
+void Simulation::setExecution(int threads, bool numaAwareMode, bool useHugePages) {
+    auto newPool = std::make_unique<ThreadPool>(threads, numaAwareMode, "sim worker");
+
+    // Move particles into fresh storage, copied slice by slice by the worker
+    // that owns it so the new pages land on that worker's node. Both arrays
+    // are placed at the base count: adaptive resolution never exceeds it, so
+    // splits and sort gathers never reallocate on the calling thread
+    int count = static_cast<int>(particles.size());
+    ParticleArray fresh{NumaAllocator<Particle>(useHugePages)};
+    ParticleArray scratch{NumaAllocator<Particle>(useHugePages)};
+    fresh.resize(baseParticleCount);
+    scratch.resize(baseParticleCount);
+    newPool->run(baseParticleCount, [&](int, int begin, int end) {
+        for (int i = begin; i < end; i++) {
+            fresh[i] = i < count ? particles[i] : Particle{};
+            scratch[i] = Particle{};
+        }
+    });
+    fresh.resize(count);
+    scratch.clear();
+
+    // Nothing below throws, so a failure above keeps the old configuration
+    numaAware = numaAwareMode;
+    hugePages = useHugePages;
+    pool = std::move(newPool);
+    particles = std::move(fresh);
+    sortScratch = std::move(scratch);
+
+    neighborBlocks.clear();
+    neighborListAge = 0;
+    sortAge = 0;
+}
+
+// Reorders particles by grid cell (row-major) so each worker's slice is a
+// compact band of the domain and most neighbor reads stay on its node
+void Simulation::sortParticlesSpatially() {
+    int n = static_cast<int>(particles.size());
+
+    // Row-major by cell; flipping the sign bit orders negative cells of an
+    // open domain before positive ones without shifting a negative value
+    std::vector<std::pair<uint64_t, int>> keys(n);
+    for (int i = 0; i < n; i++) {
+        CellKey key = getCellKey(particles[i].position);
+        uint64_t row = static_cast<uint32_t>(key.y) ^ 0x80000000u;
+        uint64_t column = static_cast<uint32_t>(key.x) ^ 0x80000000u;
+        keys[i] = {(row << 32) | column, i};
+    }
+    std::sort(keys.begin(), keys.end());
+
+    // Mid-frame under local time stepping, so the kick state moves along
+    if (localTimeStepping && kickAcceleration.size() == particles.size()) {
+        std::vector<glm::vec2> kicks(n);
+        for (int k = 0; k < n; k++) {
+            kicks[k] = kickAcceleration[keys[k].second];
+        }
+        kickAcceleration.swap(kicks);
     }
+
+    // Gather in parallel: scratch slice w is only ever written by worker w
+    if (sortScratch.size() != particles.size()) {
+        sortScratch.resize(particles.size());
+    }
+    pool->run(n, [&](int, int begin, int end) {
+        for (int k = begin; k < end; k++) {
+            sortScratch[k] = particles[keys[k].second];
+        }
+    });
+    particles.swap(sortScratch);
 }
 
 Simulation::CellKey Simulation::getCellKey(const glm::vec2& pos) const {
@@ -61,217 +184,1194 @@ Simulation::CellKey Simulation::getCellKey(const glm::vec2& pos) const {
 }
 
 void Simulation::buildGrid() {
+    updateFluidBounds();
+    if (adaptiveSmoothing) {
+        // Return the other mode's blocks to their pools
+        if (!grid.empty()) {
+            grid.clear();
+            grid.finish();
+        }
+        updateSmoothingLengths();
+        buildLevelGrids();
+        return;
+    }
+
+    for (auto& levelGrid : levelGrids) {
+        if (!levelGrid.empty()) {
+            levelGrid.clear();
+            levelGrid.finish();
+        }
+    }
     grid.clear();
     for (int i = 0; i < static_cast<int>(particles.size()); i++) {
         CellKey key = getCellKey(particles[i].position);
-        grid[key].push_back(i);
+        grid.insert(i, key.x, key.y);
     }
+    grid.finish();
 }
 
-void Simulation::computeDensityPressure() {
-    float h2 = smoothingRadius * smoothingRadius;
-    
-    for (auto& p : particles) {
-        p.density = 0.0f;
+void Simulation::updateFluidBounds() {
+    if (particles.empty()) return;
+    glm::vec2 lo = particles[0].position;
+    glm::vec2 hi = lo;
+    for (const Particle& p : particles) {
+        lo = glm::min(lo, p.position);
+        hi = glm::max(hi, p.position);
     }
-    
+    fluidMin = lo;
+    fluidMax = hi;
+}
+
+void Simulation::setDomain(const glm::vec2& min, const glm::vec2& max) {
+    domainMin = min;
+    domainMax = max;
+}
+
+void Simulation::getViewBounds(glm::vec2& min, glm::vec2& max) const {
+    float h = smoothingRadius;
+    for (int axis = 0; axis < 2; axis++) {
+        min[axis] = std::isfinite(domainMin[axis]) ? domainMin[axis] : fluidMin[axis] - h;
+        max[axis] = std::isfinite(domainMax[axis]) ? domainMax[axis] : fluidMax[axis] + h;
+    }
+}
+
+GridStats Simulation::getGridStats() const {
+    GridStats stats;
+    auto add = [&](const SparseGrid& g) {
+        stats.blocks += g.getBlockCount();
+        stats.pooledBlocks += g.getPooledBlockCount();
+        stats.bytes += g.getMemoryBytes();
+        stats.liveBytes += g.getLiveMemoryBytes();
+    };
+    add(grid);
+    for (const auto& levelGrid : levelGrids) add(levelGrid);
+    return stats;
+}
+
+void Simulation::updateSmoothingLengths() {
+    int n = static_cast<int>(particles.size());
+    float minH = ADAPTIVE_H_MIN * smoothingRadius;
+    float maxH = ADAPTIVE_H_MAX * smoothingRadius;
+    kernelCoeffs.resize(n);
+
+    pool->run(n, [&](int, int begin, int end) {
+        for (int i = begin; i < end; i++) {
+            // Constant neighbor mass in 2D: h scales with sqrt(m / ρ)
+            float massRatio = particles[i].mass / particleMass;
+            float h = std::sqrt(massRatio * restDensity / particles[i].density) * smoothingRadius;
+            h = std::min(std::max(h, minH), maxH);
+            particles[i].smoothingLength = h;
+
+            KernelCoeffs& k = kernelCoeffs[i];
+            float h2 = h * h;
+            float h5 = h2 * h2 * h;
+            k.h = h;
+            k.h2 = h2;
+            k.poly6 = 4.0f / (static_cast<float>(M_PI) * h5 * h2 * h);
+            k.spikyGrad = -10.0f / (static_cast<float>(M_PI) * h5);
+            k.viscLapl = 40.0f / (static_cast<float>(M_PI) * h5);
+        }
+    });
+}
+
+float Simulation::levelCellSize(int level) const {
+    return ADAPTIVE_H_MIN * smoothingRadius * static_cast<float>(1 << level);
+}
+
+void Simulation::buildLevelGrids() {
+    for (auto& levelGrid : levelGrids) {
+        levelGrid.clear();
+    }
+    levelMaxH.fill(0.0f);
     for (int i = 0; i < static_cast<int>(particles.size()); i++) {
-        CellKey myCell = getCellKey(particles[i].position);
-        
-        // Search 3x3 neighborhood
-        for (int dx = -1; dx <= 1; dx++) {
-            for (int dy = -1; dy <= 1; dy++) {
-                CellKey neighborCell = {myCell.x + dx, myCell.y + dy};
-                auto it = grid.find(neighborCell);
-                if (it == grid.end()) continue;
-                
-                for (int j : it->second) {
+        const Particle& p = particles[i];
+        int level = 0;
+        while (level < GRID_LEVELS - 1 && p.smoothingLength > levelCellSize(level)) {
+            level++;
+        }
+        float cell = levelCellSize(level);
+        CellKey key = {
+            static_cast<int>(std::floor(p.position.x / cell)),
+            static_cast<int>(std::floor(p.position.y / cell))
+        };
+        levelGrids[level].insert(i, key.x, key.y);
+        levelMaxH[level] = std::max(levelMaxH[level], p.smoothingLength);
+    }
+    for (auto& levelGrid : levelGrids) {
+        levelGrid.finish();
+    }
+}
+
+// Calls fn(j) for every particle of the level grids within
+// radiusScale * max(h_i, h_j) of particle i (radiusScale * h_i when
+// gatherOnly), plus some further candidates
+template <typename Fn>
+void Simulation::forEachLevelCandidate(int i, float radiusScale, bool gatherOnly, Fn&& fn) const {
+    const glm::vec2& pos = particles[i].position;
+    float h = particles[i].smoothingLength;
+
+    for (int level = 0; level < GRID_LEVELS; level++) {
+        const auto& levelGrid = levelGrids[level];
+        if (levelGrid.empty()) continue;
+
+        // Only the cells overlapping the search box, which for finer levels
+        // spans several of their (small) cells
+        float cell = levelCellSize(level);
+        float radius = (gatherOnly ? h : std::max(h, levelMaxH[level])) * radiusScale;
+        int minX = static_cast<int>(std::floor((pos.x - radius) / cell));
+        int maxX = static_cast<int>(std::floor((pos.x + radius) / cell));
+        int minY = static_cast<int>(std::floor((pos.y - radius) / cell));
+        int maxY = static_cast<int>(std::floor((pos.y + radius) / cell));
+
+        for (int x = minX; x <= maxX; x++) {
+            for (int y = minY; y <= maxY; y++) {
+                for (int j : levelGrid.cell(x, y)) {
+                    fn(j);
+                }
+            }
+        }
+    }
+}
+
+void Simulation::buildNeighborLists() {
+    int n = static_cast<int>(particles.size());
+
+    // Reused lists are gathered with a skin so that pairs drifting into
+    // range before the next rebuild are already present
+    float radius = smoothingRadius * (1.0f + neighborSkin * static_cast<float>(neighborListInterval - 1));
+    float radius2 = radius * radius;
+    int reach = static_cast<int>(std::ceil(radius / smoothingRadius));
+
+    neighborBlocks.resize(pool->getThreadCount());
+
+    pool->run(n, [&](int worker, int begin, int end) {
+        NeighborBlock& block = neighborBlocks[worker];
+        block.begin = begin;
+        block.start.resize(end - begin + 1);
+        block.list.clear();
+
+        for (int i = begin; i < end; i++) {
+            block.start[i - begin] = static_cast<int>(block.list.size());
+
+            if (adaptiveSmoothing) {
+                float skinScale = radius / smoothingRadius;
+                float hi = particles[i].smoothingLength;
+                forEachLevelCandidate(i, skinScale, false, [&](int j) {
                     glm::vec2 diff = particles[i].position - particles[j].position;
-                    float r2 = glm::dot(diff, diff);
-                    
-                    if (r2 < h2) {
-                        // Poly6 kernel
-                        float w = poly6Coeff * std::pow(h2 - r2, 3.0f);
-                        particles[i].density += particleMass * w;
+                    float pairRadius = std::max(hi, particles[j].smoothingLength) * skinScale;
+                    if (glm::dot(diff, diff) < pairRadius * pairRadius) {
+                        block.list.push_back(j);
+                    }
+                });
+                continue;
+            }
+
+            CellKey myCell = getCellKey(particles[i].position);
+
+            for (int dx = -reach; dx <= reach; dx++) {
+                for (int dy = -reach; dy <= reach; dy++) {
+                    for (int j : grid.cell(myCell.x + dx, myCell.y + dy)) {
+                        glm::vec2 diff = particles[i].position - particles[j].position;
+                        if (glm::dot(diff, diff) < radius2) {
+                            block.list.push_back(j);
+                        }
                     }
                 }
             }
         }
-        
-        // Ensure minimum density
-        particles[i].density = std::max(particles[i].density, restDensity * 0.1f);
-        
-        // Tait equation of state
-        float ratio = particles[i].density / restDensity;
-        particles[i].pressure = gasConstant * (ratio * ratio * ratio * ratio * ratio * ratio * ratio - 1.0f);
+        block.start[end - begin] = static_cast<int>(block.list.size());
+    });
+}
+
+void Simulation::refreshNeighbors() {
+    // Sorting renumbers particles, so it can only happen on a list rebuild
+    bool rebuildLists = neighborListInterval > 0 && neighborListAge % neighborListInterval == 0;
+    if ((numaAware || wavefront) && (neighborListInterval == 0 || rebuildLists) && sortAge++ % SORT_INTERVAL == 0) {
+        sortParticlesSpatially();
+    }
+
+    if (neighborListInterval == 0) {
+        buildGrid();
+        return;
+    }
+
+    if (rebuildLists) {
+        buildGrid();
+        buildNeighborLists();
+        neighborListAge = 0;
+    }
+    neighborListAge++;
+}
+
+// Calls fn(j) for every neighbor candidate of particle i (including i itself);
+// callers still apply the exact distance test.
+template <typename Fn>
+void Simulation::forEachNeighbor(int i, Fn&& fn) const {
+    if (neighborListInterval > 0) {
+        const NeighborBlock& block = neighborBlocks[pool->getWorkerOf(i, static_cast<int>(particles.size()))];
+        int local = i - block.begin;
+        for (int k = block.start[local]; k < block.start[local + 1]; k++) {
+            fn(block.list[k]);
+        }
+        return;
+    }
+
+    if (adaptiveSmoothing) {
+        forEachLevelCandidate(i, 1.0f, false, fn);
+        return;
+    }
+
+    CellKey myCell = getCellKey(particles[i].position);
+
+    // Search 3x3 neighborhood
+    for (int dx = -1; dx <= 1; dx++) {
+        for (int dy = -1; dy <= 1; dy++) {
+            for (int j : grid.cell(myCell.x + dx, myCell.y + dy)) {
+                fn(j);
+            }
+        }
+    }
+}
+
+void Simulation::computeDensityPressure() {
+    pool->run(static_cast<int>(particles.size()), [&](int, int begin, int end) {
+        for (int i = begin; i < end; i++) {
+            computeDensityPressureAt(i);
+        }
+    });
+}
+
+void Simulation::computeDensityPressureAt(int i) {
+    float h2 = smoothingRadius * smoothingRadius;
+    
+    particles[i].density = 0.0f;
+    
+    if (adaptiveSmoothing) {
+        particles[i].density = gatherDensityAdaptive(i);
+    } else {
+        forEachNeighbor(i, [&](int j) {
+            glm::vec2 diff = particles[i].position - particles[j].position;
+            float r2 = glm::dot(diff, diff);
+            
+            if (r2 < h2) {
+                // Poly6 kernel
+                float w = poly6Coeff * std::pow(h2 - r2, 3.0f);
+                particles[i].density += particles[j].mass * w;
+            }
+        });
+    }
+    
+    // Ensure minimum density
+    particles[i].density = std::max(particles[i].density, restDensity * 0.1f);
+    
+    // Tait equation of state
+    float ratio = particles[i].density / restDensity;
+    particles[i].pressure = gasConstant * (ratio * ratio * ratio * ratio * ratio * ratio * ratio - 1.0f);
+}
+
+// Density is gathered over the particle's own h
+float Simulation::gatherDensityAdaptive(int i) const {
+    const KernelCoeffs& k = kernelCoeffs[i];
+    float density = 0.0f;
+
+    auto accumulate = [&](int j) {
+        glm::vec2 diff = particles[i].position - particles[j].position;
+        float r2 = glm::dot(diff, diff);
+
+        if (r2 < k.h2) {
+            float q = k.h2 - r2;
+            density += particles[j].mass * k.poly6 * q * q * q;
+        }
+    };
+
+    // A grid search only has to reach h_i here, not the pair radius
+    if (neighborListInterval > 0) {
+        forEachNeighbor(i, accumulate);
+    } else {
+        forEachLevelCandidate(i, 1.0f, true, accumulate);
     }
+    return density;
 }
 
 void Simulation::computeForces() {
+    pool->run(static_cast<int>(particles.size()), [&](int, int begin, int end) {
+        for (int i = begin; i < end; i++) {
+            computeForcesAt(i);
+        }
+    });
+}
+
+void Simulation::computeForcesAt(int i) {
+    if (adaptiveSmoothing) {
+        computeForcesAdaptiveAt(i);
+        return;
+    }
+
     float h = smoothingRadius;
     float h2 = h * h;
     
-    for (auto& p : particles) {
-        p.force = glm::vec2(0.0f);
-    }
+    particles[i].force = glm::vec2(0.0f);
     
-    for (int i = 0; i < static_cast<int>(particles.size()); i++) {
-        CellKey myCell = getCellKey(particles[i].position);
+    forEachNeighbor(i, [&](int j) {
+        if (i == j) return;
         
-        for (int dx = -1; dx <= 1; dx++) {
-            for (int dy = -1; dy <= 1; dy++) {
-                CellKey neighborCell = {myCell.x + dx, myCell.y + dy};
-                auto it = grid.find(neighborCell);
-                if (it == grid.end()) continue;
-                
-                for (int j : it->second) {
-                    if (i == j) continue;
-                    
-                    glm::vec2 diff = particles[i].position - particles[j].position;
-                    float r2 = glm::dot(diff, diff);
-                    
-                    if (r2 < h2 && r2 > 1e-12f) {
-                        float r = std::sqrt(r2);
-                        glm::vec2 dir = diff / r;
-                        
-                        // Pressure force (Spiky kernel gradient)
-                        float pressureForce = -particleMass * 
-                            (particles[i].pressure + particles[j].pressure) / 
-                            (2.0f * particles[j].density) *
-                            spikyGradCoeff * std::pow(h - r, 2.0f);
-                        
-                        particles[i].force += pressureForce * dir;
-                        
-                        // Viscosity force (Viscosity kernel Laplacian)
-                        float viscForce = viscosity * particleMass *
-                            (1.0f / particles[j].density) *
-                            viscLaplCoeff * (h - r);
-                        
-                        particles[i].force += viscForce * (particles[j].velocity - particles[i].velocity);
-                    }
-                }
+        glm::vec2 diff = particles[i].position - particles[j].position;
+        float r2 = glm::dot(diff, diff);
+        
+        if (r2 < h2 && r2 > 1e-12f) {
+            float r = std::sqrt(r2);
+            glm::vec2 dir = diff / r;
+            
+            // Pressure force (Spiky kernel gradient)
+            float pressureForce = -particles[j].mass * 
+                (particles[i].pressure + particles[j].pressure) / 
+                (2.0f * particles[j].density) *
+                spikyGradCoeff * std::pow(h - r, 2.0f);
+            
+            particles[i].force += pressureForce * dir;
+            
+            // Viscosity force (Viscosity kernel Laplacian)
+            float viscForce = viscosity * particles[j].mass *
+                (1.0f / particles[j].density) *
+                viscLaplCoeff * (h - r);
+            
+            particles[i].force += viscForce * (particles[j].velocity - particles[i].velocity);
+        }
+    });
+    
+    // Gravity
+    particles[i].force += gravity * particles[i].density;
+}
+
+// Symmetric pair terms: kernel gradients are averaged over h_i and h_j
+void Simulation::computeForcesAdaptiveAt(int i) {
+    const KernelCoeffs& ki = kernelCoeffs[i];
+
+    particles[i].force = glm::vec2(0.0f);
+
+    forEachNeighbor(i, [&](int j) {
+        if (i == j) return;
+
+        const KernelCoeffs& kj = kernelCoeffs[j];
+        glm::vec2 diff = particles[i].position - particles[j].position;
+        float r2 = glm::dot(diff, diff);
+
+        if ((r2 < ki.h2 || r2 < kj.h2) && r2 > 1e-12f) {
+            float r = std::sqrt(r2);
+            glm::vec2 dir = diff / r;
+
+            float spiky = 0.0f, lapl = 0.0f;
+            if (r2 < ki.h2) {
+                float q = ki.h - r;
+                spiky += ki.spikyGrad * q * q;
+                lapl += ki.viscLapl * q;
             }
+            if (r2 < kj.h2) {
+                float q = kj.h - r;
+                spiky += kj.spikyGrad * q * q;
+                lapl += kj.viscLapl * q;
+            }
+
+            float pressureForce = -particles[j].mass *
+                (particles[i].pressure + particles[j].pressure) /
+                (2.0f * particles[j].density) * 0.5f * spiky;
+            particles[i].force += pressureForce * dir;
+
+            float viscForce = viscosity * particles[j].mass / particles[j].density * 0.5f * lapl;
+            particles[i].force += viscForce * (particles[j].velocity - particles[i].velocity);
         }
-        
-        // Gravity
-        particles[i].force += gravity * particles[i].density;
-    }
+    });
+
+    particles[i].force += gravity * particles[i].density;
 }
 
 void Simulation::computeXSPHCorrection() {
-    float h = smoothingRadius;
-    float h2 = h * h;
+    int n = static_cast<int>(particles.size());
 
     // Accumulate velocity corrections
     std::vector<glm::vec2> corrections(particles.size(), glm::vec2(0.0f));
 
-    for (int i = 0; i < static_cast<int>(particles.size()); i++) {
-        CellKey myCell = getCellKey(particles[i].position);
+    pool->run(n, [&](int, int begin, int end) {
+        for (int i = begin; i < end; i++) {
+            corrections[i] = computeXSPHCorrectionAt(i);
+        }
+    });
+
+    // Apply corrected velocities
+    pool->run(n, [&](int, int begin, int end) {
+        for (int i = begin; i < end; i++) {
+            particles[i].velocity += xsphEpsilon * corrections[i];
+        }
+    });
+}
 
-        for (int dx = -1; dx <= 1; dx++) {
-            for (int dy = -1; dy <= 1; dy++) {
-                CellKey neighborCell = {myCell.x + dx, myCell.y + dy};
-                auto it = grid.find(neighborCell);
-                if (it == grid.end()) continue;
+glm::vec2 Simulation::computeXSPHCorrectionAt(int i) const {
+    if (adaptiveSmoothing) return computeXSPHCorrectionAdaptiveAt(i);
 
-                for (int j : it->second) {
-                    if (i == j) continue;
+    float h = smoothingRadius;
+    float h2 = h * h;
 
-                    glm::vec2 diff = particles[i].position - particles[j].position;
-                    float r2 = glm::dot(diff, diff);
+    glm::vec2 correction(0.0f);
 
-                    if (r2 < h2 && r2 > 1e-12f) {
-                        // Poly6 kernel for XSPH
-                        float w = poly6Coeff * std::pow(h2 - r2, 3.0f);
-                        float weight = w * particleMass / particles[j].density;
+    forEachNeighbor(i, [&](int j) {
+        if (i == j) return;
 
-                        // Accumulate velocity difference
-                        corrections[i] += (particles[j].velocity - particles[i].velocity) * weight;
-                    }
-                }
+        glm::vec2 diff = particles[i].position - particles[j].position;
+        float r2 = glm::dot(diff, diff);
+
+        if (r2 < h2 && r2 > 1e-12f) {
+            // Poly6 kernel for XSPH
+            float w = poly6Coeff * std::pow(h2 - r2, 3.0f);
+            float weight = w * particles[j].mass / particles[j].density;
+
+            // Accumulate velocity difference
+            correction += (particles[j].velocity - particles[i].velocity) * weight;
+        }
+    });
+
+    return correction;
+}
+
+glm::vec2 Simulation::computeXSPHCorrectionAdaptiveAt(int i) const {
+    const KernelCoeffs& ki = kernelCoeffs[i];
+    glm::vec2 correction(0.0f);
+
+    forEachNeighbor(i, [&](int j) {
+        if (i == j) return;
+
+        const KernelCoeffs& kj = kernelCoeffs[j];
+        glm::vec2 diff = particles[i].position - particles[j].position;
+        float r2 = glm::dot(diff, diff);
+
+        if ((r2 < ki.h2 || r2 < kj.h2) && r2 > 1e-12f) {
+            float w = 0.0f;
+            if (r2 < ki.h2) {
+                float q = ki.h2 - r2;
+                w += ki.poly6 * q * q * q;
+            }
+            if (r2 < kj.h2) {
+                float q = kj.h2 - r2;
+                w += kj.poly6 * q * q * q;
             }
+            float weight = 0.5f * w * particles[j].mass / particles[j].density;
+            correction += (particles[j].velocity - particles[i].velocity) * weight;
         }
+    });
+
+    return correction;
+}
+
+void Simulation::integrate(float dt) {
+    pool->run(static_cast<int>(particles.size()), [&](int, int begin, int end) {
+        for (int i = begin; i < end; i++) {
+            integrateAt(i, dt);
+        }
+    });
+}
+
+void Simulation::integrateAt(int i, float dt) {
+    Particle& p = particles[i];
+    
+    // Semi-implicit Euler
+    p.velocity += dt * p.force / p.density;
+    
+    // Clamp velocity for stability
+    float speed = glm::length(p.velocity);
+    if (speed > 5.0f) {
+        p.velocity = (p.velocity / speed) * 5.0f;
     }
+    
+    p.position += dt * p.velocity;
+}
 
-    // Apply corrected velocities
-    for (int i = 0; i < static_cast<int>(particles.size()); i++) {
-        particles[i].velocity += xsphEpsilon * corrections[i];
+void Simulation::enforceBoundary(float impulseScale) {
+    pool->run(static_cast<int>(particles.size()), [&](int, int begin, int end) {
+        for (int i = begin; i < end; i++) {
+            enforceBoundaryAt(i, impulseScale);
+        }
+    });
+}
+
+void Simulation::enforceBoundaryAt(int i, float impulseScale) {
+    float margin = BOUNDARY_MARGIN;
+    Particle& p = particles[i];
+
+    // Penalty forces for each boundary; open sides sit at infinity,
+    // so their tests never pass
+    glm::vec2 penaltyForce(0.0f);
+
+    // Bottom boundary
+    if (p.position.y < domainMin.y + margin) {
+        float d = domainMin.y + margin - p.position.y;
+        penaltyForce.y += boundaryStiffness * d;
+        penaltyForce.y -= boundaryDamp * p.velocity.y;
     }
+    // Top boundary
+    if (p.position.y > domainMax.y - margin) {
+        float d = p.position.y - (domainMax.y - margin);
+        penaltyForce.y -= boundaryStiffness * d;
+        penaltyForce.y -= boundaryDamp * p.velocity.y;
+    }
+    // Left boundary
+    if (p.position.x < domainMin.x + margin) {
+        float d = domainMin.x + margin - p.position.x;
+        penaltyForce.x += boundaryStiffness * d;
+        penaltyForce.x -= boundaryDamp * p.velocity.x;
+    }
+    // Right boundary
+    if (p.position.x > domainMax.x - margin) {
+        float d = p.position.x - (domainMax.x - margin);
+        penaltyForce.x -= boundaryStiffness * d;
+        penaltyForce.x -= boundaryDamp * p.velocity.x;
+    }
+
+    // Apply penalty force as acceleration
+    p.velocity += penaltyForce / p.density * 0.016f * impulseScale;  // Scale for stability
+
+    // Hard clamp as fallback for extreme cases
+    p.position = glm::clamp(p.position, domainMin + glm::vec2(0.001f), domainMax - glm::vec2(0.001f));
 }
 
-void Simulation::integrate(float dt) {
-    for (auto& p : particles) {
-        // Semi-implicit Euler
-        p.velocity += dt * p.force / p.density;
-        
-        // Clamp velocity for stability
-        float speed = glm::length(p.velocity);
-        if (speed > 5.0f) {
-            p.velocity = (p.velocity / speed) * 5.0f;
+bool Simulation::canRunWavefront() const {
+    // Band b's candidates must lie in bands b - 1 .. b + 1, which the 3x3
+    // search over h-sized cells guarantees. Lists rebuilt every sub-step
+    // have no skin and hold that search's neighbors in its order.
+    return wavefront && !adaptiveSmoothing && neighborListInterval <= 1;
+}
+
+// Groups particles into bands of whole cell rows, as many rows as keep a
+// band near wavefrontBandBytes of particle data
+void Simulation::buildBands() {
+    int n = static_cast<int>(particles.size());
+    int firstRow = getCellKey(fluidMin).y;
+    int rows = getCellKey(fluidMax).y - firstRow + 1;
+    long long bandParticleTarget = wavefrontBandBytes / static_cast<int>(sizeof(Particle));
+    int bandRows = static_cast<int>(std::max(1LL, bandParticleTarget * rows / std::max(n, 1)));
+    int bands = (rows + bandRows - 1) / bandRows;
+
+    bandParticles.resize(n);
+    bandStart.assign(bands + 1, 0);
+    for (int i = 0; i < n; i++) {
+        bandStart[(getCellKey(particles[i].position).y - firstRow) / bandRows + 1]++;
+    }
+    for (int b = 0; b < bands; b++) {
+        bandStart[b + 1] += bandStart[b];
+    }
+    std::vector<int> fill(bandStart.begin(), bandStart.end() - 1);
+    for (int i = 0; i < n; i++) {
+        bandParticles[fill[(getCellKey(particles[i].position).y - firstRow) / bandRows]++] = i;
+    }
+    wavefrontBands = bands;
+}
+
+// One uniform sub-step as a wavefront over the bands. Forces and XSPH of
+// band b need the final densities of bands b - 1 .. b + 1, and band b may
+// only move once they have read its old positions and velocities, so each
+// stage trails the one before it by a band and four bands are live at once.
+void Simulation::stepWavefront(float dt) {
+    buildBands();
+    xsphCorrections.resize(particles.size());
+
+    auto runBand = [&](const char* phase, int band, const std::function<void(int)>& fn) {
+        if (band < 0 || band >= wavefrontBands) return;
+        trace::Scope scope(phase, "phase", band);
+        const int* first = bandParticles.data() + bandStart[band];
+        pool->run(bandStart[band + 1] - bandStart[band], [&](int, int begin, int end) {
+            for (int k = begin; k < end; k++) {
+                fn(first[k]);
+            }
+        });
+    };
+
+    for (int step = 0; step < wavefrontBands + 2; step++) {
+        runBand("density", step, [&](int i) { computeDensityPressureAt(i); });
+        runBand("forces", step - 1, [&](int i) { computeForcesAt(i); });
+        if (xsphEnabled) {
+            runBand("xsph", step - 1, [&](int i) { xsphCorrections[i] = computeXSPHCorrectionAt(i); });
         }
-        
-        p.position += dt * p.velocity;
+        runBand("integrate", step - 2, [&](int i) {
+            if (xsphEnabled) particles[i].velocity += xsphEpsilon * xsphCorrections[i];
+            integrateAt(i, dt);
+            enforceBoundaryAt(i, 1.0f);
+        });
     }
 }
 
-void Simulation::enforceBoundary() {
-    float margin = 0.02f;  // Boundary layer thickness
+void Simulation::update(float dt) {
+    trace::Scope updateScope("simulate", "sim");
+    simTime += dt;
+    frameIndex++;
+
+    if (adaptiveResolution) {
+        trace::Scope scope("refine resolution", "sim");
+        refineResolution();
+    }
+
+    if (localTimeStepping) {
+        trace::Scope scope("multi-rate", "sim");
+        updateMultiRate(dt);
+        return;
+    }
+
+    // Sub-step for stability
+    float subDt = dt / static_cast<float>(substeps);
+
+    for (int s = 0; s < substeps; s++) {
+        trace::Scope substepScope("substep", "sim", s);
+        {
+            trace::Scope scope("neighbors", "phase");
+            refreshNeighbors();
+        }
+        notifyPhase(SimPhase::Neighbors);
+        if (canRunWavefront()) {
+            trace::Scope scope("wavefront", "phase");
+            stepWavefront(subDt);
+            notifyPhase(SimPhase::Boundary);
+            particleUpdates += static_cast<long long>(particles.size());
+            continue;
+        }
+        wavefrontBands = 0;
+        {
+            trace::Scope scope("density", "phase");
+            computeDensityPressure();
+        }
+        notifyPhase(SimPhase::Density);
+        {
+            trace::Scope scope("forces", "phase");
+            computeForces();
+        }
+        notifyPhase(SimPhase::Forces);
+        if (xsphEnabled) {
+            {
+                trace::Scope scope("xsph", "phase");
+                computeXSPHCorrection();
+            }
+            notifyPhase(SimPhase::XSPH);
+        }
+        {
+            trace::Scope scope("integrate", "phase");
+            integrate(subDt);
+        }
+        notifyPhase(SimPhase::Integrate);
+        {
+            trace::Scope scope("boundary", "phase");
+            enforceBoundary();
+        }
+        notifyPhase(SimPhase::Boundary);
+        particleUpdates += static_cast<long long>(particles.size());
+    }
+}
+
+void Simulation::setSubsteps(int n) {
+    substeps = std::max(1, n);
+}
+
+void Simulation::setWavefrontBandBytes(int bytes) {
+    wavefrontBandBytes = std::max(1, bytes);
+}
 
+void Simulation::setNeighborListInterval(int k) {
+    neighborListInterval = std::max(0, k);
+    neighborListAge = 0;
+}
+
+void Simulation::setLocalTimeStepping(bool enabled) {
+    localTimeStepping = enabled;
+    // Every particle starts on the finest bin; the first tick re-bins them all
     for (auto& p : particles) {
-        // Penalty forces for each boundary
-        glm::vec2 penaltyForce(0.0f);
+        p.timeBin = 0;
+    }
+    updateTimeBinHistogram();
+}
+
+// Flags the particles whose density active particles will read this tick,
+// records the finest bin in each active particle's neighborhood and wakes
+// neighbors more than one bin coarser. Workers gather what to flag and wake
+// for their share of the active list, merged in worker order; woken
+// particles join the list and their neighborhoods are visited in a further
+// round.
+void Simulation::markActiveNeighborhoods(int tick, float fineDt) {
+    float h2 = smoothingRadius * smoothingRadius;
+
+    std::fill(needsDensity.begin(), needsDensity.end(), 0);
+    workerTouched.resize(pool->getThreadCount());
+    workerWake.resize(pool->getThreadCount());
+
+    size_t first = 0;
+    while (first < activeParticles.size()) {
+        size_t last = activeParticles.size();
+        for (auto& list : workerTouched) list.clear();
+        for (auto& list : workerWake) list.clear();
+
+        pool->run(static_cast<int>(last - first), [&](int worker, int begin, int end) {
+            std::vector<int>& touched = workerTouched[worker];
+            std::vector<int>& wake = workerWake[worker];
+            for (int k = begin; k < end; k++) {
+                int i = activeParticles[first + k];
+                int minBin = MAX_TIME_BIN;
+
+                forEachNeighbor(i, [&](int j) {
+                    glm::vec2 diff = particles[i].position - particles[j].position;
+                    float pairH2 = h2;
+                    if (adaptiveSmoothing) {
+                        float pairH = std::max(particles[i].smoothingLength, particles[j].smoothingLength);
+                        pairH2 = pairH * pairH;
+                    }
+                    if (glm::dot(diff, diff) < pairH2) {
+                        touched.push_back(j);
+                        if (!activeFlags[j] && particles[j].timeBin > particles[i].timeBin + 1) {
+                            wake.push_back(j);
+                        }
+                        minBin = std::min(minBin, particles[j].timeBin);
+                    }
+                });
+                neighborMinBin[i] = minBin;
+            }
+        });
+
+        for (size_t k = first; k < last; k++) {
+            needsDensity[activeParticles[k]] = 1;
+        }
+        for (int w = 0; w < pool->getThreadCount(); w++) {
+            for (int j : workerTouched[w]) needsDensity[j] = 1;
+            for (int j : workerWake[w]) {
+                if (!activeFlags[j]) wakeParticle(j, tick, fineDt);
+            }
+        }
+        first = last;
+    }
+}
+
+// Kicks land on ticks aligned to the bin, so the ticks left of the current
+// step follow from the tick alone
+void Simulation::wakeParticle(int i, int tick, float fineDt) {
+    Particle& p = particles[i];
+    int period = 1 << p.timeBin;
+    int remaining = period - tick % period;
+    p.velocity -= kickAcceleration[i] * (fineDt * static_cast<float>(remaining));
+    activeFlags[i] = 1;
+    activeParticles.push_back(i);
+    wakeCount++;
+}
+
+// CFL and force stability criteria for one particle
+float Simulation::localTimeStep(int i) const {
+    const Particle& p = particles[i];
+    float h = p.smoothingLength;
+
+    // Tait EOS with gamma = 7: c^2 = dp/drho at rest density
+    float soundSpeed = std::sqrt(7.0f * gasConstant / restDensity);
+    float dtLocal = cflFactor * h / (soundSpeed + glm::length(p.velocity));
 
-        // Bottom boundary
-        if (p.position.y < DOMAIN_MIN + margin) {
-            float d = DOMAIN_MIN + margin - p.position.y;
-            penaltyForce.y += boundaryStiffness * d;
-            penaltyForce.y -= boundaryDamp * p.velocity.y;
+    float accel = glm::length(p.force) / p.density;
+    if (accel > 1e-6f) {
+        dtLocal = std::min(dtLocal, forceFactor * std::sqrt(h / accel));
+    }
+    return dtLocal;
+}
+
+int Simulation::chooseTimeBin(int i, int tick, float fineDt) const {
+    // The largest power-of-two multiple of the tick that the particle's own
+    // criterion allows and that starts on this tick; particles that would
+    // need less than a tick stay on the finest bin, as in uniform stepping
+    float dtLocal = localTimeStep(i);
+    int bin = 0;
+    while (bin < MAX_TIME_BIN &&
+           fineDt * static_cast<float>(2 << bin) <= dtLocal &&
+           tick % (2 << bin) == 0) {
+        bin++;
+    }
+
+    // Limit the step ratio between neighbors so fast particles are not
+    // integrated against far-stale neighbor state
+    return std::min(bin, neighborMinBin[i] + 1);
+}
+
+int Simulation::getTicksPerFrame() const {
+    if (!localTimeStepping) return substeps;
+    // Ticks of at most the uniform sub-step, in whole periods of the
+    // coarsest bin
+    int period = 1 << MAX_TIME_BIN;
+    return (substeps + period - 1) / period * period;
+}
+
+void Simulation::updateMultiRate(float dt) {
+    int n = static_cast<int>(particles.size());
+    int ticks = getTicksPerFrame();
+    float fineDt = dt / static_cast<float>(ticks);
+
+    needsDensity.resize(n);
+    neighborMinBin.resize(n);
+    activeFlags.resize(n);
+    // Every step ends with the frame, so new particles need no kick yet
+    kickAcceleration.resize(n);
+    workerActive.resize(pool->getThreadCount());
+    workerMaxBin.resize(pool->getThreadCount());
+    std::vector<glm::vec2> corrections;
+
+    for (int t = 0; t < ticks; t++) {
+        trace::Scope tickScope("substep", "sim", t);
+
+        // All positions are drifted every tick, so inactive neighbors are
+        // always seen at the current time with their last kicked velocity
+        {
+            trace::Scope scope("neighbors", "phase");
+            refreshNeighbors();
+
+            // Each worker lists the active particles of its own slice;
+            // joined in worker order, the list stays in index order
+            for (auto& list : workerActive) list.clear();
+            std::fill(workerMaxBin.begin(), workerMaxBin.end(), 0);
+            pool->run(n, [&](int worker, int begin, int end) {
+                std::vector<int>& list = workerActive[worker];
+                int maxBinLocal = 0;
+                for (int i = begin; i < end; i++) {
+                    maxBinLocal = std::max(maxBinLocal, particles[i].timeBin);
+                    activeFlags[i] = t % (1 << particles[i].timeBin) == 0;
+                    if (activeFlags[i]) {
+                        list.push_back(i);
+                    }
+                }
+                workerMaxBin[worker] = maxBinLocal;
+            });
+            activeParticles.clear();
+            int maxBin = 0;
+            for (int w = 0; w < pool->getThreadCount(); w++) {
+                activeParticles.insert(activeParticles.end(), workerActive[w].begin(), workerActive[w].end());
+                maxBin = std::max(maxBin, workerMaxBin[w]);
+            }
+
+            // Density for active particles and every neighbor they read from;
+            // the remaining particles keep the density of their last evaluation.
+            // With everyone on the finest bin that is simply everyone.
+            if (maxBin == 0) {
+                std::fill(needsDensity.begin(), needsDensity.end(), 1);
+                std::fill(neighborMinBin.begin(), neighborMinBin.end(), 0);
+            } else {
+                markActiveNeighborhoods(t, fineDt);
+            }
         }
-        // Top boundary
-        if (p.position.y > DOMAIN_MAX - margin) {
-            float d = p.position.y - (DOMAIN_MAX - margin);
-            penaltyForce.y -= boundaryStiffness * d;
-            penaltyForce.y -= boundaryDamp * p.velocity.y;
+        notifyPhase(SimPhase::Neighbors);
+        {
+            trace::Scope scope("density", "phase");
+            pool->run(n, [&](int, int begin, int end) {
+                for (int i = begin; i < end; i++) {
+                    if (needsDensity[i]) computeDensityPressureAt(i);
+                }
+            });
         }
-        // Left boundary
-        if (p.position.x < DOMAIN_MIN + margin) {
-            float d = DOMAIN_MIN + margin - p.position.x;
-            penaltyForce.x += boundaryStiffness * d;
-            penaltyForce.x -= boundaryDamp * p.velocity.x;
+        notifyPhase(SimPhase::Density);
+        int activeCount = static_cast<int>(activeParticles.size());
+        {
+            trace::Scope scope("forces", "phase");
+            pool->run(activeCount, [&](int, int begin, int end) {
+                for (int k = begin; k < end; k++) {
+                    computeForcesAt(activeParticles[k]);
+                }
+            });
         }
-        // Right boundary
-        if (p.position.x > DOMAIN_MAX - margin) {
-            float d = p.position.x - (DOMAIN_MAX - margin);
-            penaltyForce.x -= boundaryStiffness * d;
-            penaltyForce.x -= boundaryDamp * p.velocity.x;
+        notifyPhase(SimPhase::Forces);
+
+        corrections.assign(activeParticles.size(), glm::vec2(0.0f));
+        if (xsphEnabled) {
+            trace::Scope scope("xsph", "phase");
+            pool->run(activeCount, [&](int, int begin, int end) {
+                for (int k = begin; k < end; k++) {
+                    corrections[k] = computeXSPHCorrectionAt(activeParticles[k]);
+                }
+            });
         }
 
-        // Apply penalty force as acceleration
-        p.velocity += penaltyForce / p.density * 0.016f;  // Scale for stability
+        // Kick active particles over their full bin step
+        {
+            trace::Scope scope("integrate", "phase");
+            pool->run(activeCount, [&](int, int begin, int end) {
+                for (int k = begin; k < end; k++) {
+                    int i = activeParticles[k];
+                    Particle& p = particles[i];
+                    p.timeBin = chooseTimeBin(i, t, fineDt);
+                    float stepDt = fineDt * static_cast<float>(1 << p.timeBin);
 
-        // Hard clamp as fallback for extreme cases
-        p.position = glm::clamp(p.position,
-            glm::vec2(DOMAIN_MIN + 0.001f),
-            glm::vec2(DOMAIN_MAX - 0.001f));
+                    kickAcceleration[i] = p.force / p.density;
+                    p.velocity += xsphEpsilon * corrections[k];
+                    p.velocity += stepDt * kickAcceleration[i];
+
+                    float speed = glm::length(p.velocity);
+                    if (speed > 5.0f) {
+                        p.velocity = (p.velocity / speed) * 5.0f;
+                    }
+                }
+            });
+        }
+        particleUpdates += static_cast<long long>(activeParticles.size());
+        notifyPhase(SimPhase::Integrate);
+
+        // Drift everyone
+        {
+            trace::Scope scope("drift", "phase");
+            pool->run(n, [&](int, int begin, int end) {
+                for (int i = begin; i < end; i++) {
+                    particles[i].position += fineDt * particles[i].velocity;
+                }
+            });
+        }
+        {
+            trace::Scope scope("boundary", "phase");
+            enforceBoundary(static_cast<float>(substeps) / static_cast<float>(ticks));
+        }
+        notifyPhase(SimPhase::Boundary);
     }
+
+    updateTimeBinHistogram();
 }
 
-void Simulation::update(float dt) {
-    // Sub-step for stability
-    int substeps = 4;
-    float subDt = dt / static_cast<float>(substeps);
+NumaStats Simulation::getNumaStats() const {
+    NumaStats stats;
+    int n = static_cast<int>(particles.size());
+    stats.nodes = numa::nodeCount();
+    stats.threads = pool->getThreadCount();
+    stats.pinned = pool->isPinned();
 
-    for (int s = 0; s < substeps; s++) {
-        buildGrid();
-        computeDensityPressure();
-        computeForces();
-        computeXSPHCorrection();
-        integrate(subDt);
-        enforceBoundary();
+    // Page placement of every worker's particle slice and neighbor block
+    long long pages = 0, remotePages = 0;
+    auto countPages = [&](int worker, const void* data, std::size_t bytes) {
+        for (int node : numa::pageNodes(data, bytes)) {
+            if (node < 0) continue;
+            pages++;
+            if (node != pool->getWorkerNode(worker)) remotePages++;
+        }
+    };
+    for (int w = 0; w < stats.threads; w++) {
+        int begin, end;
+        pool->getSlice(w, n, begin, end);
+        if (begin < end) countPages(w, &particles[begin], (end - begin) * sizeof(Particle));
+        if (neighborListInterval > 0 && w < static_cast<int>(neighborBlocks.size()) &&
+            !neighborBlocks[w].list.empty()) {
+            countPages(w, neighborBlocks[w].list.data(), neighborBlocks[w].list.size() * sizeof(int));
+        }
+    }
+    stats.remotePageFraction = pages > 0 ? static_cast<double>(remotePages) / pages : 0.0;
+
+    // Neighbor reads whose particle lives in a slice owned by another node
+    if (neighborListInterval > 0 && !neighborBlocks.empty()) {
+        long long reads = 0, remoteReads = 0;
+        for (int i = 0; i < n; i++) {
+            int node = pool->getWorkerNode(pool->getWorkerOf(i, n));
+            forEachNeighbor(i, [&](int j) {
+                reads++;
+                if (pool->getWorkerNode(pool->getWorkerOf(j, n)) != node) remoteReads++;
+            });
+        }
+        stats.remoteNeighborFraction = reads > 0 ? static_cast<double>(remoteReads) / reads : 0.0;
+    }
+    return stats;
+}
+
+std::vector<int> Simulation::getNeighborCounts() const {
+    int n = static_cast<int>(particles.size());
+    std::vector<int> counts(n, 0);
+    if (neighborListInterval > 0 && neighborBlocks.empty()) return counts;
+
+    pool->run(n, [&](int, int begin, int end) {
+        for (int i = begin; i < end; i++) {
+            float h = adaptiveSmoothing ? particles[i].smoothingLength : smoothingRadius;
+            float h2 = h * h;
+            forEachNeighbor(i, [&](int j) {
+                glm::vec2 diff = particles[i].position - particles[j].position;
+                if (j != i && glm::dot(diff, diff) < h2) counts[i]++;
+            });
+        }
+    });
+    return counts;
+}
+
+void Simulation::updateTimeBinHistogram() {
+    timeBinHistogram.fill(0);
+    for (const auto& p : particles) {
+        timeBinHistogram[p.timeBin]++;
+    }
+}
+
+void Simulation::setAdaptiveResolution(bool enabled) {
+    adaptiveResolution = enabled;
+    if (enabled && !adaptiveSmoothing) setAdaptiveSmoothing(true);
+    disturbances.clear();
+}
+
+static const uint8_t RESOLUTION_KEEP = 0;
+static const uint8_t RESOLUTION_SPLIT = 1;
+static const uint8_t RESOLUTION_MERGE = 2;
+
+// Wants base resolution near walls, applied forces, the free surface and
+// agitated flow; allows coarsening only well clear of all of them (the gap
+// between the split and merge thresholds keeps particles from flickering).
+// Agitation is the mean speed relative to neighbors, so a pool sloshing as
+// a whole still counts as calm.
+uint8_t Simulation::classifyResolution(int i, bool searchReady) const {
+    const Particle& p = particles[i];
+    float h = smoothingRadius;
+
+    float clearance = std::min(std::min(p.position.x - domainMin.x, domainMax.x - p.position.x),
+                               std::min(p.position.y - domainMin.y, domainMax.y - p.position.y));
+    for (const glm::vec3& d : disturbances) {
+        clearance = std::min(clearance, glm::length(p.position - glm::vec2(d.x, d.y)) - d.z);
+    }
+    float densityRatio = p.density / restDensity;
+    if (clearance < splitWallDistance * h || densityRatio < splitDensity) {
+        return RESOLUTION_SPLIT;
+    }
+    if (!searchReady) return RESOLUTION_KEEP;
+
+    float h2 = p.smoothingLength * p.smoothingLength;
+    float relativeSpeed = 0.0f;
+    int count = 0;
+    forEachNeighbor(i, [&](int j) {
+        glm::vec2 diff = p.position - particles[j].position;
+        if (j == i || glm::dot(diff, diff) >= h2) return;
+        relativeSpeed += glm::length(particles[j].velocity - p.velocity);
+        count++;
+    });
+    float agitation = count > 0 ? relativeSpeed / static_cast<float>(count) : 0.0f;
+
+    if (agitation > splitAgitation) {
+        return RESOLUTION_SPLIT;
+    }
+    if (clearance > mergeWallDistance * h && agitation < mergeAgitation &&
+        densityRatio > mergeDensity && count > 0) {
+        return RESOLUTION_MERGE;
+    }
+    return RESOLUTION_KEEP;
+}
+
+// j is absorbed into i at the center of mass with the combined momentum
+void Simulation::mergeParticles(int i, int j) {
+    Particle& a = particles[i];
+    const Particle& b = particles[j];
+    float mass = a.mass + b.mass;
+    float wa = a.mass / mass;
+    float wb = b.mass / mass;
+
+    a.position = wa * a.position + wb * b.position;
+    a.velocity = wa * a.velocity + wb * b.velocity;
+    a.force = a.force + b.force;
+    a.density = wa * a.density + wb * b.density;
+    a.pressure = wa * a.pressure + wb * b.pressure;
+    a.timeBin = std::min(a.timeBin, b.timeBin);
+    a.smoothingLength *= std::sqrt(2.0f);
+    a.mass = mass;
+}
+
+// Two halves placed symmetrically across the velocity (center of mass and
+// momentum unchanged); the new half is appended
+void Simulation::splitParticle(int i) {
+    Particle half = particles[i];
+    half.mass *= 0.5f;
+    half.force *= 0.5f;
+    half.smoothingLength *= std::sqrt(0.5f);
+
+    float speed = glm::length(half.velocity);
+    glm::vec2 dir = speed > 1e-6f ? glm::vec2(-half.velocity.y, half.velocity.x) / speed
+                                  : glm::vec2(1.0f, 0.0f);
+    glm::vec2 offset = dir * (0.25f * particles[i].smoothingLength);
+
+    Particle other = half;
+    half.position -= offset;
+    other.position += offset;
+    particles[i] = half;
+    particles.push_back(other);
+}
+
+void Simulation::refineResolution() {
+    int n = static_cast<int>(particles.size());
+    resolutionStats.merges = 0;
+    resolutionStats.splits = 0;
+
+    auto totals = [&](double& mass, double& px, double& py, double& momentumScale) {
+        mass = px = py = momentumScale = 0.0;
+        for (const auto& p : particles) {
+            mass += p.mass;
+            px += static_cast<double>(p.mass) * p.velocity.x;
+            py += static_cast<double>(p.mass) * p.velocity.y;
+            momentumScale += static_cast<double>(p.mass) * glm::length(p.velocity);
+        }
+    };
+    double massBefore, pxBefore, pyBefore, scaleBefore;
+    totals(massBefore, pxBefore, pyBefore, scaleBefore);
+
+    // The neighbor structure is from the last sub-step: indices are still
+    // valid and distance tests use current positions
+    bool searchReady = !(neighborListInterval > 0 && neighborBlocks.empty());
+    resolutionState.resize(n);
+    pool->run(n, [&](int, int begin, int end) {
+        for (int i = begin; i < end; i++) {
+            resolutionState[i] = classifyResolution(i, searchReady);
+        }
+    });
+    disturbances.clear();
+
+    // Merges pair each calm particle with its nearest calm partner of equal
+    // mass, greedily in index order so the result is deterministic
+    float maxMass = particleMass * static_cast<float>(1 << MAX_MASS_LEVEL);
+    std::vector<uint8_t> removed(n, 0);
+    for (int i = 0; i < n; i++) {
+        if (resolutionState[i] != RESOLUTION_MERGE || particles[i].mass * 2.0f > maxMass * 1.01f) continue;
+
+        float reach = mergeDistance * particles[i].smoothingLength;
+        float best = reach * reach;
+        int partner = -1;
+        forEachNeighbor(i, [&](int j) {
+            if (j == i || resolutionState[j] != RESOLUTION_MERGE) return;
+            if (std::abs(particles[j].mass - particles[i].mass) > 0.01f * particles[i].mass) return;
+            glm::vec2 diff = particles[i].position - particles[j].position;
+            float d2 = glm::dot(diff, diff);
+            if (d2 < best) {
+                best = d2;
+                partner = j;
+            }
+        });
+        if (partner < 0) continue;
+
+        mergeParticles(i, partner);
+        removed[partner] = 1;
+        resolutionState[i] = RESOLUTION_KEEP;
+        resolutionState[partner] = RESOLUTION_KEEP;
+        resolutionStats.merges++;
+    }
+
+    // One level per frame, so a heavy particle reaching the surface refines
+    // over a few frames rather than in one burst
+    for (int i = 0; i < n; i++) {
+        if (resolutionState[i] == RESOLUTION_SPLIT && !removed[i] &&
+            particles[i].mass > particleMass * 1.5f) {
+            splitParticle(i);
+            resolutionStats.splits++;
+        }
+    }
+
+    if (resolutionStats.merges == 0 && resolutionStats.splits == 0) return;
+
+    // Compact away the absorbed particles (appended halves are never removed)
+    int write = 0;
+    for (int r = 0; r < static_cast<int>(particles.size()); r++) {
+        if (r < n && removed[r]) continue;
+        if (write != r) particles[write] = particles[r];
+        write++;
+    }
+    particles.resize(write);
+    neighborListAge = 0;
+
+    double massAfter, pxAfter, pyAfter, scaleAfter;
+    totals(massAfter, pxAfter, pyAfter, scaleAfter);
+    resolutionStats.maxMassError = std::max(resolutionStats.maxMassError,
+        std::abs(massAfter - massBefore) / massBefore);
+    if (scaleBefore > 0.0) {
+        resolutionStats.maxMomentumError = std::max(resolutionStats.maxMomentumError,
+            std::hypot(pxAfter - pxBefore, pyAfter - pyBefore) / scaleBefore);
     }
 }
 
 void Simulation::addForce(float x, float y, float radius, float strength) {
+    if (adaptiveResolution) disturbances.push_back(glm::vec3(x, y, radius));
     for (auto& p : particles) {
         glm::vec2 diff = p.position - glm::vec2(x, y);
         float dist = glm::length(diff);
@@ -285,6 +1385,7 @@ void Simulation::addForce(float x, float y, float radius, float strength) {
 void Simulation::applyCursorForce(float x, float y, bool attract) {
     glm::vec2 cursorPos(x, y);
     float radius = CURSOR_RADIUS;
+    if (adaptiveResolution) disturbances.push_back(glm::vec3(x, y, radius));
     
     for (auto& p : particles) {
         glm::vec2 diff = p.position - cursorPos;
@@ -1,9 +1,13 @@
 #pragma once
 
 #include <vector>
+#include <array>
 #include <glm/glm.hpp>
-#include <unordered_map>
 #include <cstdint>
+#include <memory>
+#include "Numa.h"
+#include "SparseGrid.h"
+#include "ThreadPool.h"
 
 struct Particle {
     glm::vec2 position;
@@ -11,11 +15,56 @@ struct Particle {
     glm::vec2 force;
     float density;
     float pressure;
+    int timeBin;          // Local time stepping bin (step = finest step * 2^bin)
+    float smoothingLength; // Per-particle h (equal to the global h unless adaptive)
+    float mass;           // Base mass * 2^level under adaptive resolution
+};
+
+// Particle storage is left untouched on allocation so each worker first-touches
+// (and thereby places) its own slice; see Simulation::reset
+using ParticleArray = std::vector<Particle, NumaAllocator<Particle>>;
+
+struct ResolutionStats {
+    int merges = 0;                   // During the last frame
+    int splits = 0;
+    double maxMassError = 0.0;        // Relative, worst over all refinements
+    double maxMomentumError = 0.0;    // Relative to the total |momentum|
+};
+
+struct GridStats {
+    int blocks = 0;                   // Allocated, over all grid levels
+    int pooledBlocks = 0;             // Allocated + free for reuse
+    std::size_t bytes = 0;            // Block pools and hashes
+    std::size_t liveBytes = 0;        // Live blocks and hashes
+};
+
+struct NumaStats {
+    int nodes = 1;
+    int threads = 1;
+    bool pinned = false;
+    double remotePageFraction = 0.0;      // Pages on a node other than their owning worker's
+    double remoteNeighborFraction = 0.0;  // Neighbor reads that cross a node boundary
+};
+
+// Phases of one uniform sub-step, in execution order
+enum class SimPhase { Neighbors, Density, Forces, XSPH, Integrate, Boundary };
+
+class Simulation;
+
+// Inspection hook called after each phase of a uniform sub-step (validation
+// tools compare the state against a reference here). The multi-rate path
+// reports every tick, XSPH folded into Integrate, and only steps
+// getActiveParticles() on it.
+class PhaseObserver {
+public:
+    virtual ~PhaseObserver() = default;
+    virtual void afterPhase(SimPhase phase, const Simulation& sim) = 0;
 };
 
 class Simulation {
 public:
     Simulation(int numParticles = 2000);
+    ~Simulation();
 
     void update(float dt);
     void reset();
@@ -24,17 +73,149 @@ public:
     void toggleGravity();
     void setGravityDirection(float x, float y);
 
+    // SPH parameters
+    glm::vec2 getGravity() const { return gravity; }
+    void setViscosity(float mu) { viscosity = mu; }
+    float getViscosity() const { return viscosity; }
+    void setGasConstant(float k) { gasConstant = k; }
+    float getGasConstant() const { return gasConstant; }
+    void setSmoothingRadius(float h);
+    float getSmoothingRadius() const { return smoothingRadius; }
+    float getRestDensity() const { return restDensity; }
+    float getParticleMass() const { return particleMass; }  // Base mass
+    float getXSPHEpsilon() const { return xsphEpsilon; }
+
+    // Adaptive smoothing: every grid rebuild sets each particle's h to
+    // h * sqrt(ρ₀ / ρ) from its last density, clamped to
+    // [ADAPTIVE_H_MIN, ADAPTIVE_H_MAX] * h. Density gathers over the particle's
+    // own h; forces and XSPH average the kernels of both particles so pairs
+    // stay symmetric. Neighbors come from a multi-level grid.
+    static constexpr float ADAPTIVE_H_MIN = 0.7f;
+    static constexpr float ADAPTIVE_H_MAX = 2.5f;
+    void setAdaptiveSmoothing(bool enabled);
+    bool isAdaptiveSmoothing() const { return adaptiveSmoothing; }
+    // Other particles within each particle's own h, as of the last sub-step
+    std::vector<int> getNeighborCounts() const;
+
+    // Adaptive resolution: once per frame, pairs of calm interior particles
+    // of equal mass merge into one of twice the mass, and heavy particles
+    // near the free surface, the walls, fast flow or applied forces split
+    // back toward the base mass. Both conserve mass, momentum and center of
+    // mass, and arrays stay dense; the count never exceeds the constructed
+    // one. Turns adaptive smoothing on, since h must follow mass.
+    static constexpr int MAX_MASS_LEVEL = 2;   // Heaviest particle = base mass * 2^level
+    void setAdaptiveResolution(bool enabled);
+    bool isAdaptiveResolution() const { return adaptiveResolution; }
+    const ResolutionStats& getResolutionStats() const { return resolutionStats; }
+    // k for a particle of base mass * 2^k
+    int getMassLevel(const Particle& p) const {
+        int level = 0;
+        while (level < MAX_MASS_LEVEL && p.mass > particleMass * 1.5f * static_cast<float>(1 << level)) level++;
+        return level;
+    }
+
     static constexpr float CURSOR_RADIUS = 0.18f;
+
+    // Multi-rate stepping: a tick is the uniform sub-step and a particle in
+    // bin b is only integrated every 2^b ticks, so bins run from the uniform
+    // sub-step (bin 0) to 2^MAX_TIME_BIN times it. Each particle takes the
+    // coarsest bin its own CFL/force criterion allows, so calm particles
+    // step less often and no particle steps more often than uniformly. A
+    // neighbor more than one bin coarser than an active particle is woken:
+    // the unused rest of its kick is taken back and it is stepped that tick.
+    static constexpr int MAX_TIME_BIN = 2;
+    void setLocalTimeStepping(bool enabled);
+    bool isLocalTimeStepping() const { return localTimeStepping; }
+    const std::array<int, MAX_TIME_BIN + 1>& getTimeBinHistogram() const { return timeBinHistogram; }
+    long long getParticleUpdateCount() const { return particleUpdates; }
+    // Neighbors woken early, since construction
+    long long getWakeCount() const { return wakeCount; }
+    // Sub-steps (uniform) or ticks (multi-rate) per update(); a particle in
+    // bin b steps dt / ticks * 2^b
+    int getTicksPerFrame() const;
+    // Particles stepped on the current multi-rate tick
+    const std::vector<int>& getActiveParticles() const { return activeParticles; }
+
+    // Quality knobs (used by FrameGovernor to trade accuracy for frame time)
+    void setSubsteps(int n);
+    int getSubsteps() const { return substeps; }
+    void setXSPHEnabled(bool enabled) { xsphEnabled = enabled; }
+    bool isXSPHEnabled() const { return xsphEnabled; }
+    // 0 = search the grid in every phase; k >= 1 = cache per-particle neighbor
+    // lists and rebuild them every k sub-steps (k > 1 may miss new neighbors)
+    void setNeighborListInterval(int k);
+    int getNeighborListInterval() const { return neighborListInterval; }
+
+    // Wavefront execution: a uniform sub-step runs density, forces, XSPH and
+    // integration band by band over rows of grid cells, each phase one band
+    // behind the phase before it, so a band is still cached when the next
+    // phase reads it instead of every phase streaming the whole particle
+    // array. Particles are kept sorted by cell, so bands are contiguous, and
+    // results match the phase-at-a-time schedule on the same order bit for
+    // bit. Covers the fixed-h grid search and lists rebuilt every sub-step
+    // (the governor's top levels); adaptive smoothing and reused lists run
+    // phase at a time. An attached PhaseObserver sees
+    // only Neighbors and Boundary of a wavefront sub-step.
+    static constexpr int WAVEFRONT_BAND_BYTES = 128 * 1024;   // Particle data per band
+    void setWavefront(bool enabled) { wavefront = enabled; }
+    bool isWavefront() const { return wavefront; }
+    // Smaller bands give small scenes several bands, as validate needs
+    void setWavefrontBandBytes(int bytes);
+    // Bands of the last sub-step, 0 when it ran phase at a time
+    int getWavefrontBandCount() const { return wavefrontBands; }
+
+    // Parallel execution. threads = 0 uses every hardware thread. With
+    // numaAware, workers are pinned to NUMA nodes, particles are kept sorted
+    // into spatially coherent slices and storage is re-allocated so each
+    // slice is first-touched by its worker; hugePages requests THP backing.
+    // Placement covers the particles (at the base count, which resolution
+    // changes only shift slightly) and the per-worker neighbor lists; the
+    // cell grid is built on the calling thread and is not partitioned.
+    void setExecution(int threads, bool numaAware = false, bool hugePages = false);
+    int getThreadCount() const { return pool->getThreadCount(); }
+    bool isNumaAware() const { return numaAware; }
+    NumaStats getNumaStats() const;
+
+    // Not owned; nullptr (the default) disables phase reporting
+    void setPhaseObserver(PhaseObserver* observer) { phaseObserver = observer; }
     
-    const std::vector<Particle>& getParticles() const { return particles; }
+    const ParticleArray& getParticles() const { return particles; }
     int getParticleCount() const { return static_cast<int>(particles.size()); }
+    double getSimTime() const { return simTime; }
+    long long getFrameIndex() const { return frameIndex; }
     
-    // Simulation domain [0, 1] x [0, 1]
+    // Default domain [0, 1] x [0, 1]
     static constexpr float DOMAIN_MIN = 0.0f;
     static constexpr float DOMAIN_MAX = 1.0f;
+    // Wall layer in which the boundary penalty acts
+    static constexpr float BOUNDARY_MARGIN = 0.02f;
+
+    // Walls at min and max; an infinite component leaves that side open, so
+    // the fluid can spread without bound. The neighbor grid is sparse, so its
+    // cost follows the occupied area however large the domain. reset()
+    // places the fluid block in the unit square whatever the domain.
+    void setDomain(const glm::vec2& min, const glm::vec2& max);
+    glm::vec2 getDomainMin() const { return domainMin; }
+    glm::vec2 getDomainMax() const { return domainMax; }
+    // Region to frame when drawing: the walls where the domain has them,
+    // the particle bounds (plus h) along open sides
+    void getViewBounds(glm::vec2& min, glm::vec2& max) const;
+    // Particle bounds as of the last grid rebuild
+    void getFluidBounds(glm::vec2& min, glm::vec2& max) const { min = fluidMin; max = fluidMax; }
+    GridStats getGridStats() const;
 
 private:
-    std::vector<Particle> particles;
+    ParticleArray particles;
+    double simTime = 0.0;
+    long long frameIndex = 0;
+    ParticleArray sortScratch;
+
+    std::unique_ptr<ThreadPool> pool;
+    PhaseObserver* phaseObserver = nullptr;
+    bool numaAware = false;
+    bool hugePages = false;
+    int sortAge = 0;
+    static constexpr int SORT_INTERVAL = 16;  // Sub-steps between spatial sorts
     
     // SPH parameters
     float smoothingRadius = 0.04f;        // h
@@ -43,9 +224,34 @@ private:
     float viscosity = 250.0f;             // μ
     glm::vec2 gravity = glm::vec2(0.0f, -1.5f);  // g (scaled for [0,1] domain)
     float particleMass = 1.0f;
+    int baseParticleCount = 0;
+    glm::vec2 domainMin{DOMAIN_MIN};
+    glm::vec2 domainMax{DOMAIN_MAX};
+    glm::vec2 fluidMin{DOMAIN_MIN};       // Particle bounds, updated with the grid
+    glm::vec2 fluidMax{DOMAIN_MAX};
 
     // XSPH velocity smoothing
     float xsphEpsilon = 0.05f;
+    bool xsphEnabled = true;
+
+    // Local time stepping criteria
+    float cflFactor = 0.4f;               // dt <= C * h / (c + |v|)
+    float forceFactor = 0.25f;            // dt <= C * sqrt(h / |a|)
+    bool localTimeStepping = false;
+    std::array<int, MAX_TIME_BIN + 1> timeBinHistogram{};
+    std::vector<int> activeParticles;
+    std::vector<int> neighborMinBin;
+    std::vector<uint8_t> needsDensity;
+    std::vector<uint8_t> activeFlags;          // Stepped on the current tick
+    std::vector<std::vector<int>> workerActive;   // Per-worker share of activeParticles
+    std::vector<int> workerMaxBin;
+    std::vector<std::vector<int>> workerTouched;   // Neighbors whose density is read
+    std::vector<std::vector<int>> workerWake;
+    std::vector<glm::vec2> kickAcceleration;   // force / density of the last kick
+    long long particleUpdates = 0;
+    long long wakeCount = 0;
+
+    int substeps = 4;
 
     // Boundary penalty forces
     float boundaryStiffness = 10000.0f;
@@ -56,27 +262,107 @@ private:
     float spikyGradCoeff;
     float viscLaplCoeff;
     
-    // Spatial hashing
+    // Spatial hashing: cells of size h in a sparse block grid
     struct CellKey {
         int x, y;
-        bool operator==(const CellKey& other) const {
-            return x == other.x && y == other.y;
-        }
     };
     
-    struct CellKeyHash {
-        std::size_t operator()(const CellKey& k) const {
-            return std::hash<int64_t>()(static_cast<int64_t>(k.x) * 73856093 ^ static_cast<int64_t>(k.y) * 19349663);
-        }
+    SparseGrid grid;
+
+    // Adaptive smoothing: level l holds the particles with
+    // h <= cell size ADAPTIVE_H_MIN * h * 2^l (and above the level below);
+    // each level is searched over the cells within max(h_i, levelMaxH)
+    struct KernelCoeffs {
+        float h, h2;
+        float poly6, spikyGrad, viscLapl;
     };
+    static constexpr int GRID_LEVELS = 3;
+    static_assert(ADAPTIVE_H_MIN * (1 << (GRID_LEVELS - 1)) >= ADAPTIVE_H_MAX,
+                  "coarsest level must hold the largest h");
+    bool adaptiveSmoothing = false;
+    std::array<SparseGrid, GRID_LEVELS> levelGrids;
+    std::array<float, GRID_LEVELS> levelMaxH{};
+    std::vector<KernelCoeffs> kernelCoeffs;
+
+    // Adaptive resolution criteria; distances in units of the base h
+    bool adaptiveResolution = false;
+    float splitWallDistance = 2.0f;       // Split within this distance of a wall or force
+    float mergeWallDistance = 3.0f;       // Merge only beyond it
+    float splitAgitation = 1.5f;          // Mean speed relative to neighbors
+    float mergeAgitation = 0.5f;
+    float splitDensity = 0.95f;           // × ρ₀: lighter particles are at the surface
+    float mergeDensity = 1.05f;
+    float mergeDistance = 0.7f;           // Partner within this fraction of h_i
+    std::vector<glm::vec3> disturbances;  // x, y, radius of forces since the last refinement
+    std::vector<uint8_t> resolutionState;
+    ResolutionStats resolutionStats;
+
+    // Cached neighbor lists, one CSR block per worker slice so each worker
+    // builds (and first-touches) the lists it reads: neighbors of particle
+    // i = block.begin + k are block.list[block.start[k] .. block.start[k + 1])
+    struct NeighborBlock {
+        int begin = 0;
+        std::vector<int> start;
+        std::vector<int> list;
+    };
+    int neighborListInterval = 0;
+    float neighborSkin = 0.1f;            // Extra radius per reused sub-step, in units of h
+    int neighborListAge = 0;
+    std::vector<NeighborBlock> neighborBlocks;
+
+    // Wavefront bands: particles of band b are
+    // bandParticles[bandStart[b] .. bandStart[b + 1]), in index order
+    bool wavefront = false;
+    int wavefrontBandBytes = WAVEFRONT_BAND_BYTES;
+    int wavefrontBands = 0;
+    std::vector<int> bandStart;
+    std::vector<int> bandParticles;
+    std::vector<glm::vec2> xsphCorrections;
     
-    std::unordered_map<CellKey, std::vector<int>, CellKeyHash> grid;
-    
+    void updateKernelCoefficients();
     void buildGrid();
+    void updateFluidBounds();
+    void updateSmoothingLengths();
+    void buildLevelGrids();
+    float levelCellSize(int level) const;
+    template <typename Fn>
+    void forEachLevelCandidate(int i, float radiusScale, bool gatherOnly, Fn&& fn) const;
+    void sortParticlesSpatially();
+    void firstTouchParticles();
+    void buildNeighborLists();
+    void refreshNeighbors();
+    template <typename Fn>
+    void forEachNeighbor(int i, Fn&& fn) const;
     CellKey getCellKey(const glm::vec2& pos) const;
     void computeDensityPressure();
+    void computeDensityPressureAt(int i);
+    float gatherDensityAdaptive(int i) const;
     void computeForces();
+    void computeForcesAt(int i);
+    void computeForcesAdaptiveAt(int i);
     void computeXSPHCorrection();
+    glm::vec2 computeXSPHCorrectionAt(int i) const;
+    glm::vec2 computeXSPHCorrectionAdaptiveAt(int i) const;
     void integrate(float dt);
-    void enforceBoundary();
+    void integrateAt(int i, float dt);
+    void enforceBoundary(float impulseScale = 1.0f);
+    void enforceBoundaryAt(int i, float impulseScale);
+    bool canRunWavefront() const;
+    void buildBands();
+    void stepWavefront(float dt);
+    void notifyPhase(SimPhase phase) {
+        if (phaseObserver) phaseObserver->afterPhase(phase, *this);
+    }
+
+    void updateMultiRate(float dt);
+    void markActiveNeighborhoods(int tick, float fineDt);
+    void wakeParticle(int i, int tick, float fineDt);
+    float localTimeStep(int i) const;
+    int chooseTimeBin(int i, int tick, float fineDt) const;
+    void updateTimeBinHistogram();
+
+    void refineResolution();
+    uint8_t classifyResolution(int i, bool searchReady) const;
+    void mergeParticles(int i, int j);
+    void splitParticle(int i);
 };
@@ -0,0 +1,410 @@
+#include "SoftwareRenderer.h"
+#include "DensityField.h"
+#include "Tracer.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+
+// Constants shared with the GLSL shaders in Renderer.cpp and shaders/
+static const float CALM_COLOR[3] = { 0.05f, 0.15f, 0.6f };
+static const float FAST_COLOR[3] = { 0.2f, 0.8f, 1.0f };
+static const float VERY_FAST_COLOR[3] = { 0.85f, 0.95f, 1.0f };
+static const float GLOW_COLOR[3] = { 0.1f, 0.2f, 0.3f };
+static const float BG_TOP[3] = { 0.02f, 0.03f, 0.08f };
+static const float BG_BOTTOM[3] = { 0.05f, 0.07f, 0.15f };
+static const float LINE_COLOR[3] = { 0.15f, 0.35f, 0.65f };
+static const float LINE_ALPHA = 0.8f;
+static const float LINE_WIDTH = 2.0f;
+static const float SURFACE_COLOR[3] = { 0.75f, 0.9f, 1.0f };
+
+static float smoothstep(float edge0, float edge1, float x) {
+    float t = std::min(std::max((x - edge0) / (edge1 - edge0), 0.0f), 1.0f);
+    return t * t * (3.0f - 2.0f * t);
+}
+
+SoftwareRenderer::SoftwareRenderer(int threads)
+    : pool(std::make_unique<ThreadPool>(threads, false, "raster worker")) {}
+
+SoftwareRenderer::~SoftwareRenderer() = default;
+
+void SoftwareRenderer::resize(int w, int h) {
+    width = w;
+    height = h;
+    tilesX = (w + TILE_SIZE - 1) / TILE_SIZE;
+    tilesY = (h + TILE_SIZE - 1) / TILE_SIZE;
+    pixels.assign(static_cast<size_t>(w) * h * 3, 0);
+    base.assign(static_cast<size_t>(w) * h * 3, 0.0f);
+
+    bins.assign(pool->getThreadCount(), std::vector<std::vector<int>>(tilesX * tilesY));
+    lineBins.assign(tilesX * tilesY, {});
+}
+
+// Samples the particle.frag profile at every pixel of the footprint for
+// each sub-pixel offset of the sprite center
+void SoftwareRenderer::buildStamps(StampSet& set, float pointSize) {
+    set.pointSize = pointSize;
+    int stampSize = static_cast<int>(std::ceil(pointSize)) + 1;
+    set.size = stampSize;
+    size_t variantSize = static_cast<size_t>(stampSize) * stampSize;
+    set.alpha.assign(variantSize * SUBPIXEL * SUBPIXEL, 0.0f);
+    set.glow.assign(variantSize * SUBPIXEL * SUBPIXEL, 0.0f);
+    set.spans.assign(static_cast<size_t>(stampSize) * SUBPIXEL * SUBPIXEL * 2, 0);
+
+    float radius = pointSize * 0.5f;
+    for (int qy = 0; qy < SUBPIXEL; qy++) {
+        for (int qx = 0; qx < SUBPIXEL; qx++) {
+            int variantIndex = qy * SUBPIXEL + qx;
+            size_t variant = static_cast<size_t>(variantIndex) * variantSize;
+            for (int j = 0; j < stampSize; j++) {
+                int* span = &set.spans[(static_cast<size_t>(variantIndex) * stampSize + j) * 2];
+                span[0] = stampSize;
+                span[1] = 0;
+                // Pixel center relative to the sprite center, in point-size units
+                float dy = (static_cast<float>(j) + 0.5f - radius - static_cast<float>(qy) / SUBPIXEL) / pointSize;
+                for (int i = 0; i < stampSize; i++) {
+                    float dx = (static_cast<float>(i) + 0.5f - radius - static_cast<float>(qx) / SUBPIXEL) / pointSize;
+                    float dist = std::sqrt(dx * dx + dy * dy);
+                    if (dist > 0.5f) continue;
+
+                    size_t index = variant + static_cast<size_t>(j) * stampSize + i;
+                    set.alpha[index] = 1.0f - smoothstep(0.3f, 0.5f, dist);
+                    set.glow[index] = 1.0f - dist * 1.5f;
+                    span[0] = std::min(span[0], i);
+                    span[1] = i + 1;
+                }
+            }
+        }
+    }
+}
+
+// Background gradient with vignette, then the domain walls blended on top.
+// Both are static for a given size and view, so they are baked once.
+void SoftwareRenderer::buildBase() {
+    for (int y = 0; y < height; y++) {
+        float v = 1.0f - (static_cast<float>(y) + 0.5f) / static_cast<float>(height);
+        for (int x = 0; x < width; x++) {
+            float u = (static_cast<float>(x) + 0.5f) / static_cast<float>(width);
+            float vignette = 1.0f - std::sqrt((u - 0.5f) * (u - 0.5f) + (v - 0.5f) * (v - 0.5f)) * 0.5f;
+            float* dst = &base[(static_cast<size_t>(y) * width + x) * 3];
+            for (int c = 0; c < 3; c++) {
+                dst[c] = (BG_BOTTOM[c] + (BG_TOP[c] - BG_BOTTOM[c]) * v) * vignette;
+            }
+        }
+    }
+
+    // Each GL_LINES segment covers pixel centers within LINE_WIDTH / 2 of it
+    auto blendRect = [&](float x0, float y0, float x1, float y1) {
+        int xBegin = std::max(0, static_cast<int>(std::ceil(x0 - 0.5f)));
+        int xEnd = std::min(width, static_cast<int>(std::ceil(x1 - 0.5f)));
+        int yBegin = std::max(0, static_cast<int>(std::ceil(y0 - 0.5f)));
+        int yEnd = std::min(height, static_cast<int>(std::ceil(y1 - 0.5f)));
+        for (int y = yBegin; y < yEnd; y++) {
+            for (int x = xBegin; x < xEnd; x++) {
+                float* dst = &base[(static_cast<size_t>(y) * width + x) * 3];
+                for (int c = 0; c < 3; c++) {
+                    dst[c] = LINE_COLOR[c] * LINE_ALPHA + dst[c] * (1.0f - LINE_ALPHA);
+                }
+            }
+        }
+    };
+
+    // Walls are axis-aligned: widen each across its direction
+    float half = LINE_WIDTH * 0.5f;
+    for (int k = 0; k < wallCount; k++) {
+        glm::vec2 a = toPixel(walls[k].x, walls[k].y);
+        glm::vec2 b = toPixel(walls[k].z, walls[k].w);
+        if (a.y == b.y) {
+            blendRect(std::min(a.x, b.x), a.y - half, std::max(a.x, b.x), a.y + half);
+        } else {
+            blendRect(a.x - half, std::min(a.y, b.y), a.x + half, std::max(a.y, b.y));
+        }
+    }
+}
+
+void SoftwareRenderer::render(const Simulation& sim, int w, int h) {
+    trace::Scope renderScope("render", "render");
+    // Same projection as Renderer; along open sides the view follows the
+    // fluid, so the base is rebuilt whenever the view or walls move
+    View newView = fitView(sim, w, h);
+    glm::vec4 newWalls[4];
+    int newWallCount = domainWalls(sim, newView, newWalls);
+    bool viewChanged = newView.center.x != view.center.x || newView.center.y != view.center.y ||
+                       newView.pixelsPerUnit != view.pixelsPerUnit || newWallCount != wallCount;
+    for (int k = 0; k < newWallCount && !viewChanged; k++) {
+        viewChanged = newWalls[k].x != walls[k].x || newWalls[k].y != walls[k].y ||
+                      newWalls[k].z != walls[k].z || newWalls[k].w != walls[k].w;
+    }
+    view = newView;
+    std::copy(newWalls, newWalls + newWallCount, walls);
+    wallCount = newWallCount;
+    float scale = view.pixelsPerUnit;
+    float offsetX = static_cast<float>(w) * 0.5f;
+    float offsetY = static_cast<float>(h) * 0.5f;
+
+    if (w != width || h != height) {
+        resize(w, h);
+        buildBase();
+    } else if (viewChanged) {
+        buildBase();
+    }
+
+    float pointSize = std::max(4.0f, static_cast<float>(h) * 0.012f);
+    pointSize *= std::sqrt(static_cast<float>(decimation));
+    // Point area follows mass
+    for (int level = 0; level <= Simulation::MAX_MASS_LEVEL; level++) {
+        float levelSize = pointSize * std::sqrt(static_cast<float>(1 << level));
+        if (levelSize != stamps[level].pointSize) {
+            buildStamps(stamps[level], levelSize);
+        }
+    }
+
+    // Vertex stage: project, color and bin every drawn particle. Workers own
+    // contiguous slices, so walking the bins in worker order keeps particle
+    // order (and the float blend result) independent of the thread count.
+    const auto& particles = sim.getParticles();
+    int count = (sim.getParticleCount() + decimation - 1) / decimation;
+    sprites.resize(count);
+
+    {
+        trace::Scope scope("vertex", "render");
+        // Cleared up front: workers with an empty slice are never called
+        for (auto& workerBins : bins) {
+            for (auto& bin : workerBins) bin.clear();
+        }
+        pool->run(count, [&](int worker, int begin, int end) {
+            for (int k = begin; k < end; k++) {
+                const Particle& p = particles[static_cast<size_t>(k) * decimation];
+                Sprite& s = sprites[k];
+                s.level = sim.getMassLevel(p);
+                const StampSet& set = stamps[s.level];
+                float radius = set.pointSize * 0.5f;
+
+                // Left/top edge of the point, split into a pixel and a snapped
+                // sub-pixel offset
+                float left = (p.position.x - view.center.x) * scale + offsetX - radius;
+                float top = offsetY - (p.position.y - view.center.y) * scale - radius;
+                int qx = static_cast<int>(std::lround((left - std::floor(left)) * SUBPIXEL));
+                int qy = static_cast<int>(std::lround((top - std::floor(top)) * SUBPIXEL));
+                s.x = static_cast<int>(std::floor(left)) + qx / SUBPIXEL;
+                s.y = static_cast<int>(std::floor(top)) + qy / SUBPIXEL;
+                s.stamp = (qy % SUBPIXEL) * SUBPIXEL + qx % SUBPIXEL;
+
+                float speedNorm = std::min(std::max(glm::length(p.velocity) * 2.0f, 0.0f), 1.0f);
+                const float* from = speedNorm < 0.5f ? CALM_COLOR : FAST_COLOR;
+                const float* to = speedNorm < 0.5f ? FAST_COLOR : VERY_FAST_COLOR;
+                float t = speedNorm < 0.5f ? speedNorm * 2.0f : (speedNorm - 0.5f) * 2.0f;
+                s.r = from[0] + (to[0] - from[0]) * t;
+                s.g = from[1] + (to[1] - from[1]) * t;
+                s.b = from[2] + (to[2] - from[2]) * t;
+                s.alpha = std::min(std::max(p.density / 2000.0f, 0.3f), 1.0f) * 0.85f;
+
+                int x1 = s.x + set.size - 1;
+                int y1 = s.y + set.size - 1;
+                if (x1 < 0 || y1 < 0 || s.x >= width || s.y >= height) continue;
+
+                int tx0 = std::max(0, s.x) / TILE_SIZE;
+                int tx1 = std::min(width - 1, x1) / TILE_SIZE;
+                int ty0 = std::max(0, s.y) / TILE_SIZE;
+                int ty1 = std::min(height - 1, y1) / TILE_SIZE;
+                for (int ty = ty0; ty <= ty1; ty++) {
+                    for (int tx = tx0; tx <= tx1; tx++) {
+                        bins[worker][ty * tilesX + tx].push_back(k);
+                    }
+                }
+            }
+        });
+        binSurface();
+    }
+
+    // Fragment stage: tiles are claimed dynamically since the fluid covers
+    // only part of the screen
+    trace::Scope fragmentScope("fragment", "render");
+    std::atomic<int> nextTile{0};
+    int tileCount = tilesX * tilesY;
+    pool->run(pool->getThreadCount(), [&](int, int, int) {
+        for (int tile = nextTile++; tile < tileCount; tile = nextTile++) {
+            shadeTile(tile);
+        }
+    });
+}
+
+void SoftwareRenderer::shadeTile(int tile) {
+    // Planar accumulators so the per-row blend is a plain vector loop
+    float accumR[TILE_SIZE * TILE_SIZE];
+    float accumG[TILE_SIZE * TILE_SIZE];
+    float accumB[TILE_SIZE * TILE_SIZE];
+
+    int x0 = (tile % tilesX) * TILE_SIZE;
+    int y0 = (tile / tilesX) * TILE_SIZE;
+    int tw = std::min(TILE_SIZE, width - x0);
+    int th = std::min(TILE_SIZE, height - y0);
+
+    for (int y = 0; y < th; y++) {
+        const float* src = &base[(static_cast<size_t>(y0 + y) * width + x0) * 3];
+        for (int x = 0; x < tw; x++) {
+            accumR[y * TILE_SIZE + x] = src[x * 3 + 0];
+            accumG[y * TILE_SIZE + x] = src[x * 3 + 1];
+            accumB[y * TILE_SIZE + x] = src[x * 3 + 2];
+        }
+    }
+
+    // Additive blend (GL_SRC_ALPHA, GL_ONE) of every sprite touching the tile.
+    // Fragment colors are clamped to [0, 1] as a UNORM target would; sprites
+    // too dark to reach 1 even at full glow skip the clamp.
+    // Contributions are non-negative and only clamped on write-out, so once
+    // every pixel of the tile has saturated the remaining sprites are skipped.
+    int sinceCheck = 0;
+    bool saturated = false;
+    for (const auto& workerBins : bins) {
+        for (int k : workerBins[tile]) {
+            if (++sinceCheck == SATURATION_CHECK_INTERVAL) {
+                sinceCheck = 0;
+                if (isSaturated(accumR, accumG, accumB, tw, th)) {
+                    saturated = true;
+                    break;
+                }
+            }
+
+            const Sprite& s = sprites[k];
+            const StampSet& set = stamps[s.level];
+            int stampSize = set.size;
+            size_t variantSize = static_cast<size_t>(stampSize) * stampSize;
+            float sr = s.r, sg = s.g, sb = s.b, sa = s.alpha;
+            float glowR = GLOW_COLOR[0], glowG = GLOW_COLOR[1], glowB = GLOW_COLOR[2];
+            bool saturates = sr + glowR > 1.0f || sg + glowG > 1.0f || sb + glowB > 1.0f;
+
+            int yBegin = std::max(y0, s.y);
+            int yEnd = std::min(y0 + th, s.y + stampSize);
+            const int* spans = &set.spans[static_cast<size_t>(s.stamp) * stampSize * 2];
+            const float* alphaBase = &set.alpha[s.stamp * variantSize];
+            const float* glowBase = &set.glow[s.stamp * variantSize];
+
+            for (int y = yBegin; y < yEnd; y++) {
+                int j = y - s.y;
+                int xBegin = std::max(x0, s.x + spans[j * 2]);
+                int xEnd = std::min(x0 + tw, s.x + spans[j * 2 + 1]);
+                if (xBegin >= xEnd) continue;
+
+                size_t stampRow = static_cast<size_t>(j) * stampSize + (xBegin - s.x);
+                const float* alpha = alphaBase + stampRow;
+                const float* glow = glowBase + stampRow;
+                int row = (y - y0) * TILE_SIZE + (xBegin - x0);
+                float* dstR = accumR + row;
+                float* dstG = accumG + row;
+                float* dstB = accumB + row;
+                int span = xEnd - xBegin;
+
+                if (saturates) {
+                    for (int i = 0; i < span; i++) {
+                        float a = alpha[i] * sa;
+                        dstR[i] += std::min(sr + glowR * glow[i], 1.0f) * a;
+                        dstG[i] += std::min(sg + glowG * glow[i], 1.0f) * a;
+                        dstB[i] += std::min(sb + glowB * glow[i], 1.0f) * a;
+                    }
+                } else {
+                    for (int i = 0; i < span; i++) {
+                        float a = alpha[i] * sa;
+                        dstR[i] += (sr + glowR * glow[i]) * a;
+                        dstG[i] += (sg + glowG * glow[i]) * a;
+                        dstB[i] += (sb + glowB * glow[i]) * a;
+                    }
+                }
+            }
+        }
+        if (saturated) break;
+    }
+
+    drawLines(tile, accumR, accumG, accumB);
+    writeTile(tile, accumR, accumG, accumB);
+}
+
+// Projects the surface segments to pixels and files each under the tiles
+// its LINE_WIDTH-wide footprint overlaps
+void SoftwareRenderer::binSurface() {
+    lines.clear();
+    for (auto& bin : lineBins) bin.clear();
+    if (!surface) return;
+
+    float half = LINE_WIDTH * 0.5f;
+    for (const SurfaceSegment& s : surface->getSegments()) {
+        glm::vec2 a = toPixel(s.a.x, s.a.y);
+        glm::vec2 b = toPixel(s.b.x, s.b.y);
+        glm::vec4 line(a.x, a.y, b.x, b.y);
+        int x0 = static_cast<int>(std::floor(std::min(line.x, line.z) - half));
+        int x1 = static_cast<int>(std::floor(std::max(line.x, line.z) + half));
+        int y0 = static_cast<int>(std::floor(std::min(line.y, line.w) - half));
+        int y1 = static_cast<int>(std::floor(std::max(line.y, line.w) + half));
+        if (x1 < 0 || y1 < 0 || x0 >= width || y0 >= height) continue;
+
+        int index = static_cast<int>(lines.size());
+        lines.push_back(line);
+        for (int ty = std::max(0, y0) / TILE_SIZE; ty <= std::min(height - 1, y1) / TILE_SIZE; ty++) {
+            for (int tx = std::max(0, x0) / TILE_SIZE; tx <= std::min(width - 1, x1) / TILE_SIZE; tx++) {
+                lineBins[ty * tilesX + tx].push_back(index);
+            }
+        }
+    }
+}
+
+// Alpha-blends (GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA) the surface over the
+// particles at pixel centers within LINE_WIDTH / 2 of a segment. The
+// additive particles are clamped first, as the UNORM target would be.
+void SoftwareRenderer::drawLines(int tile, float* r, float* g, float* b) {
+    int x0 = (tile % tilesX) * TILE_SIZE;
+    int y0 = (tile / tilesX) * TILE_SIZE;
+    int tw = std::min(TILE_SIZE, width - x0);
+    int th = std::min(TILE_SIZE, height - y0);
+    float half = LINE_WIDTH * 0.5f;
+
+    for (int index : lineBins[tile]) {
+        const glm::vec4& line = lines[index];
+        glm::vec2 a(line.x, line.y);
+        glm::vec2 ab(line.z - line.x, line.w - line.y);
+        float lengthSq = std::max(glm::dot(ab, ab), 1e-12f);
+
+        int xBegin = std::max(x0, static_cast<int>(std::floor(std::min(line.x, line.z) - half)));
+        int xEnd = std::min(x0 + tw, static_cast<int>(std::ceil(std::max(line.x, line.z) + half)));
+        int yBegin = std::max(y0, static_cast<int>(std::floor(std::min(line.y, line.w) - half)));
+        int yEnd = std::min(y0 + th, static_cast<int>(std::ceil(std::max(line.y, line.w) + half)));
+        for (int y = yBegin; y < yEnd; y++) {
+            for (int x = xBegin; x < xEnd; x++) {
+                glm::vec2 p(static_cast<float>(x) + 0.5f, static_cast<float>(y) + 0.5f);
+                float t = std::min(std::max(glm::dot(p - a, ab) / lengthSq, 0.0f), 1.0f);
+                glm::vec2 d = p - (a + ab * t);
+                if (glm::dot(d, d) > half * half) continue;
+
+                int i = (y - y0) * TILE_SIZE + (x - x0);
+                r[i] = SURFACE_COLOR[0] * LINE_ALPHA + std::min(r[i], 1.0f) * (1.0f - LINE_ALPHA);
+                g[i] = SURFACE_COLOR[1] * LINE_ALPHA + std::min(g[i], 1.0f) * (1.0f - LINE_ALPHA);
+                b[i] = SURFACE_COLOR[2] * LINE_ALPHA + std::min(b[i], 1.0f) * (1.0f - LINE_ALPHA);
+            }
+        }
+    }
+}
+
+bool SoftwareRenderer::isSaturated(const float* r, const float* g, const float* b, int tw, int th) const {
+    for (int y = 0; y < th; y++) {
+        for (int x = 0; x < tw; x++) {
+            int index = y * TILE_SIZE + x;
+            if (r[index] < 1.0f || g[index] < 1.0f || b[index] < 1.0f) return false;
+        }
+    }
+    return true;
+}
+
+void SoftwareRenderer::writeTile(int tile, const float* r, const float* g, const float* b) {
+    int x0 = (tile % tilesX) * TILE_SIZE;
+    int y0 = (tile / tilesX) * TILE_SIZE;
+    int tw = std::min(TILE_SIZE, width - x0);
+    int th = std::min(TILE_SIZE, height - y0);
+
+    for (int y = 0; y < th; y++) {
+        uint8_t* dst = &pixels[(static_cast<size_t>(y0 + y) * width + x0) * 3];
+        for (int x = 0; x < tw; x++) {
+            int index = y * TILE_SIZE + x;
+            dst[x * 3 + 0] = static_cast<uint8_t>(std::min(r[index], 1.0f) * 255.0f + 0.5f);
+            dst[x * 3 + 1] = static_cast<uint8_t>(std::min(g[index], 1.0f) * 255.0f + 0.5f);
+            dst[x * 3 + 2] = static_cast<uint8_t>(std::min(b[index], 1.0f) * 255.0f + 0.5f);
+        }
+    }
+}
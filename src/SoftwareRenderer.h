@@ -0,0 +1,97 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "Simulation.h"
+#include "ThreadPool.h"
+#include "View.h"
+
+class DensityField;
+
+// CPU rasterizer reproducing Renderer's look (gradient background with
+// vignette, domain walls, additive point sprites shaded like particle.frag)
+// without an OpenGL context. Particles are binned into screen tiles and the
+// tiles are shaded in parallel, each worker compositing one tile at a time
+// in a cache-resident float buffer.
+class SoftwareRenderer {
+public:
+    // threads = 0 uses every hardware thread
+    explicit SoftwareRenderer(int threads = 0);
+    ~SoftwareRenderer();
+
+    void render(const Simulation& sim, int width, int height);
+
+    // Draw only every n-th particle (enlarged to keep coverage)
+    void setDecimation(int n) { decimation = n > 1 ? n : 1; }
+
+    // Free-surface contours drawn over the particles, as in Renderer. Not
+    // owned; nullptr (the default) hides them.
+    void setSurface(const DensityField* field) { surface = field; }
+
+    // Last rendered frame as packed 8-bit RGB, top row first
+    const std::vector<uint8_t>& getPixels() const { return pixels; }
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+
+private:
+    static constexpr int TILE_SIZE = 64;
+    static constexpr int SUBPIXEL = 8;      // Sprite centers snap to 1/8 pixel
+    static constexpr int SATURATION_CHECK_INTERVAL = 256;  // Sprites between tile checks
+
+    // Per-particle values the fragment shader would see, placed on the
+    // pixel grid: the sprite's footprint is a size^2 block at (x, y)
+    struct Sprite {
+        int x, y;               // Top-left pixel of the footprint (y down)
+        int level;              // Mass level, selects the stamp set
+        int stamp;              // Sub-pixel variant in the set's alpha/glow
+        float r, g, b;          // Speed ramp color
+        float alpha;            // Density factor * 0.85
+    };
+
+    std::unique_ptr<ThreadPool> pool;
+    int decimation = 1;
+    const DensityField* surface = nullptr;
+    int width = 0;
+    int height = 0;
+    int tilesX = 0;
+    int tilesY = 0;
+    View view;                                      // As of the last render
+    glm::vec4 walls[4];                             // Domain walls drawn into base
+    int wallCount = -1;
+
+    std::vector<float> base;                        // Background + walls, RGB
+    std::vector<uint8_t> pixels;
+    std::vector<Sprite> sprites;
+    std::vector<std::vector<std::vector<int>>> bins; // [worker][tile] -> sprites
+
+    // Surface segments in pixel coordinates, binned by the tiles they cross
+    std::vector<glm::vec4> lines;
+    std::vector<std::vector<int>> lineBins;          // [tile] -> lines
+
+    // Sprite profile (1 - smoothstep edge and inner glow; zero outside the
+    // circle) for every sub-pixel offset, so shading is a dense multiply-add.
+    // One set per mass level: heavier particles draw larger, like decimation.
+    struct StampSet {
+        float pointSize = 0.0f;
+        int size = 0;
+        std::vector<float> alpha;
+        std::vector<float> glow;
+        std::vector<int> spans;        // [variant][row] -> first, end column inside the circle
+    };
+    std::array<StampSet, Simulation::MAX_MASS_LEVEL + 1> stamps;
+
+    void resize(int w, int h);
+    void buildBase();
+    static void buildStamps(StampSet& set, float pointSize);
+    void binSurface();
+    glm::vec2 toPixel(float x, float y) const {
+        return glm::vec2((x - view.center.x) * view.pixelsPerUnit + static_cast<float>(width) * 0.5f,
+                         static_cast<float>(height) * 0.5f - (y - view.center.y) * view.pixelsPerUnit);
+    }
+    void shadeTile(int tile);
+    void drawLines(int tile, float* r, float* g, float* b);
+    bool isSaturated(const float* r, const float* g, const float* b, int tw, int th) const;
+    void writeTile(int tile, const float* r, const float* g, const float* b);
+};
@@ -0,0 +1,169 @@
+#include "SparseGrid.h"
+#include <algorithm>
+
+void SparseGrid::clear() {
+    // Blocks stay allocated (and hashed) until finish() finds them empty, so
+    // a particle that stays put reuses its block
+    for (int slot : live) {
+        Block& block = blocks[slot];
+        block.count = 0;
+        std::fill(block.cellFill, block.cellFill + BLOCK_CELLS, 0);
+    }
+    entries.clear();
+}
+
+void SparseGrid::insert(int index, int cellX, int cellY) {
+    // Arithmetic right shifts, so negative cells floor into their block; the
+    // offset within it multiplies back, as shifting a negative left is undefined
+    int blockX = cellX >> BLOCK_SHIFT;
+    int blockY = cellY >> BLOCK_SHIFT;
+    if (lastSlot < 0 || blockX != lastX || blockY != lastY) {
+        lastSlot = findBlock(blockX, blockY);
+        if (lastSlot < 0) lastSlot = allocateBlock(blockX, blockY);
+        lastX = blockX;
+        lastY = blockY;
+    }
+
+    int cell = (cellY - blockY * BLOCK_SIZE) * BLOCK_SIZE + (cellX - blockX * BLOCK_SIZE);
+    Block& block = blocks[lastSlot];
+    block.count++;
+    block.cellFill[cell]++;
+    entries.push_back({ index, lastSlot, cell });
+}
+
+void SparseGrid::finish() {
+    // Return emptied blocks to the pool
+    size_t kept = 0;
+    for (int slot : live) {
+        if (blocks[slot].count > 0) {
+            live[kept++] = slot;
+        } else {
+            freeSlots.push_back(slot);
+        }
+    }
+    if (kept != live.size()) {
+        live.resize(kept);
+        if (blocks.size() > MIN_POOL_BLOCKS && blocks.size() > POOL_SLACK * live.size()) {
+            trimPool();
+        } else {
+            rebuildTable(table.size());
+        }
+        lastSlot = -1;
+    }
+
+    // Counting sort: cell ranges are laid out block by block
+    int offset = 0;
+    for (int slot : live) {
+        Block& block = blocks[slot];
+        for (int c = 0; c < BLOCK_CELLS; c++) {
+            block.cellStart[c] = offset;
+            offset += block.cellFill[c];
+            block.cellFill[c] = block.cellStart[c];
+        }
+        block.cellStart[BLOCK_CELLS] = offset;
+    }
+
+    indices.resize(offset);
+    for (const Entry& e : entries) {
+        indices[blocks[e.slot].cellFill[e.cell]++] = e.index;
+    }
+}
+
+SparseGrid::Range SparseGrid::cell(int cellX, int cellY) const {
+    int blockX = cellX >> BLOCK_SHIFT;
+    int blockY = cellY >> BLOCK_SHIFT;
+    int slot = findBlock(blockX, blockY);
+    if (slot < 0) return {};
+
+    const Block& block = blocks[slot];
+    int cell = (cellY - blockY * BLOCK_SIZE) * BLOCK_SIZE + (cellX - blockX * BLOCK_SIZE);
+    const int* data = indices.data();
+    return { data + block.cellStart[cell], data + block.cellStart[cell + 1] };
+}
+
+// Compacts the live blocks to the front of a fresh pool and hash sized for
+// them; entries of this rebuild follow their blocks to the new slots
+void SparseGrid::trimPool() {
+    std::vector<int> newSlot(blocks.size(), -1);
+    std::vector<Block> kept;
+    kept.reserve(live.size());
+    for (int& slot : live) {
+        newSlot[slot] = static_cast<int>(kept.size());
+        kept.push_back(blocks[slot]);
+        slot = newSlot[slot];
+    }
+    blocks.swap(kept);
+    for (Entry& e : entries) {
+        e.slot = newSlot[e.slot];
+    }
+    std::vector<int>().swap(freeSlots);
+
+    std::size_t capacity = 64;
+    while (capacity < live.size() * 2) capacity *= 2;
+    std::vector<int32_t>().swap(table);
+    rebuildTable(capacity);
+}
+
+std::size_t SparseGrid::getLiveMemoryBytes() const {
+    return live.size() * sizeof(Block) + table.capacity() * sizeof(int32_t);
+}
+
+std::size_t SparseGrid::getMemoryBytes() const {
+    return blocks.capacity() * sizeof(Block) +
+           (freeSlots.capacity() + live.capacity()) * sizeof(int) +
+           table.capacity() * sizeof(int32_t);
+}
+
+uint32_t SparseGrid::hashBlock(int x, int y) {
+    uint32_t h = static_cast<uint32_t>(x) * 0x9E3779B1u ^ static_cast<uint32_t>(y) * 0x85EBCA77u;
+    return h ^ (h >> 16);
+}
+
+int SparseGrid::findBlock(int x, int y) const {
+    if (table.empty()) return -1;
+    size_t mask = table.size() - 1;
+    for (size_t h = hashBlock(x, y) & mask; table[h] >= 0; h = (h + 1) & mask) {
+        const Block& block = blocks[table[h]];
+        if (block.x == x && block.y == y) return table[h];
+    }
+    return -1;
+}
+
+int SparseGrid::allocateBlock(int x, int y) {
+    int slot;
+    if (!freeSlots.empty()) {
+        slot = freeSlots.back();
+        freeSlots.pop_back();
+    } else {
+        slot = static_cast<int>(blocks.size());
+        blocks.emplace_back();
+    }
+    Block& block = blocks[slot];
+    block.x = x;
+    block.y = y;
+    block.count = 0;
+    std::fill(block.cellFill, block.cellFill + BLOCK_CELLS, 0);
+    live.push_back(slot);
+
+    // Load factor at most 1/2 keeps probe chains short
+    if (live.size() * 2 > table.size()) {
+        rebuildTable(std::max<size_t>(64, table.size() * 2));
+    } else {
+        size_t mask = table.size() - 1;
+        size_t h = hashBlock(x, y) & mask;
+        while (table[h] >= 0) h = (h + 1) & mask;
+        table[h] = slot;
+    }
+    return slot;
+}
+
+void SparseGrid::rebuildTable(std::size_t capacity) {
+    table.assign(capacity, -1);
+    if (capacity == 0) return;
+    size_t mask = capacity - 1;
+    for (int slot : live) {
+        size_t h = hashBlock(blocks[slot].x, blocks[slot].y) & mask;
+        while (table[h] >= 0) h = (h + 1) & mask;
+        table[h] = slot;
+    }
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Uniform grid over the unbounded plane, stored sparsely: cells are grouped
+// into BLOCK_SIZE x BLOCK_SIZE blocks, taken from a pool where particles are
+// and returned to it once they empty; a pool left mostly free (after a
+// splash recedes) is trimmed back. An open-addressing block hash maps
+// block coordinates to pool slots, so memory and rebuild cost follow the
+// occupied area rather than the bounding box.
+// Each rebuild is clear(), insert() per particle, then finish(); a cell
+// lists its particles in insertion order.
+class SparseGrid {
+public:
+    static constexpr int BLOCK_SHIFT = 3;
+    static constexpr int BLOCK_SIZE = 1 << BLOCK_SHIFT;      // Cells per block side
+    static constexpr int BLOCK_CELLS = BLOCK_SIZE * BLOCK_SIZE;
+
+    // Particle indices of one cell
+    struct Range {
+        const int* first = nullptr;
+        const int* last = nullptr;
+        const int* begin() const { return first; }
+        const int* end() const { return last; }
+    };
+
+    void clear();
+    void insert(int index, int cellX, int cellY);
+    void finish();
+
+    // Empty for cells in unallocated blocks
+    Range cell(int cellX, int cellY) const;
+
+    bool empty() const { return live.empty(); }
+    int getBlockCount() const { return static_cast<int>(live.size()); }
+    int getPooledBlockCount() const { return static_cast<int>(blocks.size()); }   // Live + free
+    // Block pool and hash; the particle index arrays, which follow the
+    // particle count rather than the area, are not included
+    std::size_t getMemoryBytes() const;
+    // Live blocks and the hash alone
+    std::size_t getLiveMemoryBytes() const;
+
+private:
+    // The pool is trimmed to its live blocks once it holds more than
+    // POOL_SLACK times as many (and more than MIN_POOL_BLOCKS)
+    static constexpr std::size_t POOL_SLACK = 4;
+    static constexpr std::size_t MIN_POOL_BLOCKS = 64;
+
+    struct Block {
+        int x = 0, y = 0;               // Block coordinates
+        int count = 0;                  // Particles this rebuild
+        int cellStart[BLOCK_CELLS + 1]; // Into indices, valid after finish()
+        int cellFill[BLOCK_CELLS];      // Counts, then write cursors
+    };
+
+    struct Entry {
+        int index;
+        int slot;
+        int cell;
+    };
+
+    std::vector<Block> blocks;          // Pool; slots are reused, never moved out
+    std::vector<int> freeSlots;
+    std::vector<int> live;              // Allocated slots
+    std::vector<int32_t> table;         // Block hash: slot or -1, power-of-two size
+    std::vector<Entry> entries;         // Inserted since clear()
+    std::vector<int> indices;           // Particles grouped by block, then cell
+    int lastX = 0, lastY = 0, lastSlot = -1;   // Consecutive inserts mostly share a block
+
+    static uint32_t hashBlock(int x, int y);
+    int findBlock(int x, int y) const;
+    int allocateBlock(int x, int y);
+    void rebuildTable(std::size_t capacity);
+    void trimPool();
+};
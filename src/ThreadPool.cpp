@@ -0,0 +1,113 @@
+#include "ThreadPool.h"
+#include "Numa.h"
+#include "Tracer.h"
+#include <algorithm>
+
+ThreadPool::ThreadPool(int threadCount, bool pinToNodes, const char* name) {
+    if (threadCount <= 0) {
+        threadCount = static_cast<int>(std::thread::hardware_concurrency());
+    }
+    this->threadCount = std::max(1, threadCount);
+
+    // Consecutive workers share a node, so consecutive slices do too
+    int nodes = pinToNodes ? numa::nodeCount() : 1;
+    workerNodes.resize(this->threadCount);
+    for (int w = 0; w < this->threadCount; w++) {
+        workerNodes[w] = w * nodes / this->threadCount;
+    }
+
+    // A single worker runs on the calling thread
+    if (this->threadCount == 1) {
+        pinned = pinToNodes && numa::pinCurrentThreadToNode(0);
+        return;
+    }
+
+    pinned = pinToNodes;
+    try {
+        for (int w = 0; w < this->threadCount; w++) {
+            threads.emplace_back([this, w, name] {
+                if (pinned) numa::pinCurrentThreadToNode(workerNodes[w]);
+                trace::setThreadName(name, w);
+                workerLoop(w);
+            });
+        }
+    } catch (...) {
+        // The destructor will not run, and joinable threads would terminate
+        stopWorkers();
+        throw;
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    stopWorkers();
+}
+
+void ThreadPool::stopWorkers() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    workReady.notify_all();
+    for (auto& t : threads) {
+        t.join();
+    }
+}
+
+void ThreadPool::getSlice(int worker, int count, int& begin, int& end) const {
+    int chunk = (count + threadCount - 1) / threadCount;
+    begin = std::min(count, worker * chunk);
+    end = std::min(count, begin + chunk);
+}
+
+int ThreadPool::getWorkerOf(int index, int count) const {
+    int chunk = (count + threadCount - 1) / threadCount;
+    return index / chunk;
+}
+
+void ThreadPool::run(int count, const std::function<void(int, int, int)>& fn) {
+    if (threads.empty()) {
+        fn(0, 0, count);
+        workerNodes[0] = numa::currentNode();
+        return;
+    }
+
+    std::unique_lock<std::mutex> lock(mutex);
+    task = &fn;
+    taskLabel = trace::currentScope();
+    taskCount = count;
+    pending = threadCount;
+    generation++;
+    workReady.notify_all();
+    workDone.wait(lock, [this] { return pending == 0; });
+    task = nullptr;
+}
+
+void ThreadPool::workerLoop(int worker) {
+    int seenGeneration = 0;
+    while (true) {
+        const std::function<void(int, int, int)>* fn;
+        const char* label;
+        int count;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            workReady.wait(lock, [&] { return stopping || generation != seenGeneration; });
+            if (stopping) return;
+            seenGeneration = generation;
+            fn = task;
+            label = taskLabel;
+            count = taskCount;
+        }
+
+        int begin, end;
+        getSlice(worker, count, begin, end);
+        if (begin < end) {
+            // Named after the phase that dispatched it
+            trace::Scope scope(label ? label : "task", "worker", worker);
+            (*fn)(worker, begin, end);
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        workerNodes[worker] = numa::currentNode();
+        if (--pending == 0) workDone.notify_one();
+    }
+}
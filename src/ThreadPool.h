@@ -0,0 +1,54 @@
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Persistent worker pool with a static partition: worker w always receives
+// the same contiguous slice of an index range, so data a worker first
+// touches stays local to it across calls.
+class ThreadPool {
+public:
+    // threadCount = 0 uses every hardware thread. With pinToNodes, workers are
+    // spread over the NUMA nodes in order and pinned to their node's CPUs.
+    // Worker trace tracks are labelled "<name> <w>"; name must outlive the
+    // constructor's threads (a string literal).
+    explicit ThreadPool(int threadCount = 0, bool pinToNodes = false, const char* name = "worker");
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Calls fn(worker, begin, end) once for every worker's slice of [0, count)
+    // and returns when all slices are done
+    void run(int count, const std::function<void(int, int, int)>& fn);
+
+    int getThreadCount() const { return threadCount; }
+    bool isPinned() const { return pinned; }
+    // Node the worker ran its last slice on (its assigned node when pinned)
+    int getWorkerNode(int worker) const { return workerNodes[worker]; }
+
+    void getSlice(int worker, int count, int& begin, int& end) const;
+    int getWorkerOf(int index, int count) const;
+
+private:
+    int threadCount;
+    bool pinned = false;
+    std::vector<int> workerNodes;
+    std::vector<std::thread> threads;
+
+    std::mutex mutex;
+    std::condition_variable workReady;
+    std::condition_variable workDone;
+    const std::function<void(int, int, int)>* task = nullptr;
+    const char* taskLabel = nullptr;      // Caller's open trace scope
+    int taskCount = 0;
+    int generation = 0;
+    int pending = 0;
+    bool stopping = false;
+
+    void workerLoop(int worker);
+    void stopWorkers();
+};
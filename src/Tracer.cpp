@@ -0,0 +1,238 @@
+#include "Tracer.h"
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace trace {
+
+namespace detail {
+std::atomic<bool> enabled{false};
+}
+
+namespace {
+
+struct Event {
+    const char* name;
+    const char* category;
+    uint64_t startNanos;
+    uint64_t durationNanos;
+    int index;
+};
+
+// Events live in fixed chunks that are never moved, so the collector can
+// read the first `count` of them while the owner keeps appending
+constexpr uint32_t CHUNK_EVENTS = 16384;
+constexpr uint32_t MAX_CHUNKS = 256;     // 4M events per thread and session
+
+struct ThreadBuffer {
+    int tid = 0;
+    char name[32] = {};
+    // Owner-written; a new session is noticed by its generation, so only
+    // the owner ever resets count
+    std::atomic<uint32_t> generation{0};
+    std::atomic<uint32_t> count{0};
+    std::atomic<uint32_t> dropped{0};
+    bool retired = false;       // Owner exited; guarded by registryMutex
+    std::unique_ptr<Event[]> chunks[MAX_CHUNKS];
+};
+
+std::mutex registryMutex;
+std::vector<std::unique_ptr<ThreadBuffer>> registry;
+std::atomic<uint32_t> sessionGeneration{0};
+std::atomic<int64_t> sessionStartNanos{0};   // steady_clock, read by every thread
+
+// Hands the buffer back when its thread exits, so recreated pools reuse the
+// buffers (and chunks) of the workers they replace instead of growing the
+// registry
+struct BufferOwner {
+    ThreadBuffer* buffer = nullptr;
+    ~BufferOwner() {
+        if (!buffer) return;
+        std::lock_guard<std::mutex> lock(registryMutex);
+        buffer->retired = true;
+    }
+};
+
+thread_local BufferOwner localOwner;
+thread_local const char* openScope = nullptr;
+
+// A retired buffer still holding events of the current session is kept
+// until stop() has read them
+bool reusable(const ThreadBuffer& b) {
+    return b.retired && (b.count.load(std::memory_order_relaxed) == 0 ||
+                         b.generation.load(std::memory_order_relaxed) !=
+                             sessionGeneration.load(std::memory_order_relaxed));
+}
+
+ThreadBuffer& buffer() {
+    if (!localOwner.buffer) {
+        std::lock_guard<std::mutex> lock(registryMutex);
+        ThreadBuffer* b = nullptr;
+        for (const auto& candidate : registry) {
+            if (reusable(*candidate)) {
+                b = candidate.get();
+                break;
+            }
+        }
+        if (b) {
+            b->retired = false;
+            b->count.store(0, std::memory_order_relaxed);
+            b->dropped.store(0, std::memory_order_relaxed);
+        } else {
+            registry.push_back(std::make_unique<ThreadBuffer>());
+            b = registry.back().get();
+            b->tid = static_cast<int>(registry.size());
+        }
+        std::snprintf(b->name, sizeof(b->name), "thread %d", b->tid);
+        localOwner.buffer = b;
+    }
+    return *localOwner.buffer;
+}
+
+int64_t steadyNanos() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+uint64_t nowNanos() {
+    return static_cast<uint64_t>(steadyNanos() - sessionStartNanos.load(std::memory_order_relaxed));
+}
+
+void append(const Event& event) {
+    ThreadBuffer& b = buffer();
+    uint32_t generation = sessionGeneration.load(std::memory_order_acquire);
+    if (b.generation.load(std::memory_order_relaxed) != generation) {
+        b.count.store(0, std::memory_order_relaxed);
+        b.dropped.store(0, std::memory_order_relaxed);
+        b.generation.store(generation, std::memory_order_release);
+    }
+
+    uint32_t n = b.count.load(std::memory_order_relaxed);
+    uint32_t chunk = n / CHUNK_EVENTS;
+    if (chunk >= MAX_CHUNKS) {
+        b.dropped.store(b.dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        return;
+    }
+    if (!b.chunks[chunk]) b.chunks[chunk].reset(new Event[CHUNK_EVENTS]);
+    b.chunks[chunk][n % CHUNK_EVENTS] = event;
+    b.count.store(n + 1, std::memory_order_release);
+}
+
+// Names are literals from this codebase; escape anyway so the JSON stays valid
+void writeString(std::ostream& out, const char* s) {
+    out << '"';
+    for (; *s; s++) {
+        if (*s == '"' || *s == '\\') out << '\\';
+        out << *s;
+    }
+    out << '"';
+}
+
+} // namespace
+
+void start() {
+    std::lock_guard<std::mutex> lock(registryMutex);
+    sessionStartNanos.store(steadyNanos(), std::memory_order_relaxed);
+    sessionGeneration.fetch_add(1, std::memory_order_release);
+    detail::enabled.store(true, std::memory_order_release);
+}
+
+SessionStats stop(const std::string& path) {
+    SessionStats stats;
+    detail::enabled.store(false, std::memory_order_release);
+
+    std::lock_guard<std::mutex> lock(registryMutex);
+    uint32_t generation = sessionGeneration.load(std::memory_order_acquire);
+
+    // Events appended after this point (scopes still open) are not read
+    std::vector<std::pair<const ThreadBuffer*, uint32_t>> buffers;
+    for (const auto& b : registry) {
+        if (b->generation.load(std::memory_order_acquire) != generation) continue;
+        uint32_t count = b->count.load(std::memory_order_acquire);
+        if (count == 0) continue;
+        buffers.emplace_back(b.get(), count);
+        stats.events += count;
+        stats.dropped += b->dropped.load(std::memory_order_relaxed);
+        stats.threads++;
+        // Read below while the lock is held, after which nothing needs the
+        // events of an exited thread
+        if (b->retired) b->count.store(0, std::memory_order_relaxed);
+    }
+    if (stats.events == 0 || path.empty()) return stats;
+
+    std::ofstream out(path);
+    if (!out) {
+        std::cerr << "ERROR::TRACE: Failed to open " << path << std::endl;
+        return stats;
+    }
+
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    out << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"hydration\"}}";
+    char number[64];
+    for (const auto& [b, count] : buffers) {
+        out << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << b->tid
+            << ",\"args\":{\"name\":";
+        writeString(out, b->name);
+        out << "}}";
+
+        for (uint32_t i = 0; i < count; i++) {
+            const Event& e = b->chunks[i / CHUNK_EVENTS][i % CHUNK_EVENTS];
+            out << ",\n{\"name\":";
+            writeString(out, e.name);
+            out << ",\"cat\":";
+            writeString(out, e.category);
+            // Microseconds with nanosecond resolution
+            std::snprintf(number, sizeof(number), ",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f",
+                          e.startNanos / 1000.0, e.durationNanos / 1000.0);
+            out << number << ",\"pid\":1,\"tid\":" << b->tid;
+            if (e.index >= 0) out << ",\"args\":{\"index\":" << e.index << "}";
+            out << "}";
+        }
+    }
+    out << "\n]}\n";
+
+    stats.written = static_cast<bool>(out);
+    if (!stats.written) {
+        std::cerr << "ERROR::TRACE: Failed to write " << path << std::endl;
+    }
+    return stats;
+}
+
+void setThreadName(const char* name, int index) {
+    ThreadBuffer& b = buffer();
+    std::lock_guard<std::mutex> lock(registryMutex);
+    if (index >= 0) {
+        std::snprintf(b.name, sizeof(b.name), "%s %d", name, index);
+    } else {
+        std::snprintf(b.name, sizeof(b.name), "%s", name);
+    }
+}
+
+const char* currentScope() {
+    return isEnabled() ? openScope : nullptr;
+}
+
+void Scope::begin(const char* scopeName, const char* scopeCategory, int scopeIndex) {
+    name = scopeName;
+    category = scopeCategory;
+    index = scopeIndex;
+    parent = openScope;
+    openScope = scopeName;
+    generation = sessionGeneration.load(std::memory_order_relaxed);
+    startNanos = nowNanos();
+}
+
+void Scope::end() {
+    uint64_t endNanos = nowNanos();
+    openScope = parent;
+    // A scope still open when the session ended is dropped; one opened in
+    // an earlier session is too, as its start is on the old clock
+    if (!isEnabled() || generation != sessionGeneration.load(std::memory_order_relaxed)) return;
+    append({ name, category, startNanos, endNanos - startNanos, index });
+}
+
+} // namespace trace
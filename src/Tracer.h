@@ -0,0 +1,67 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+// Scoped-event tracer that writes Chrome trace-event JSON (open it in
+// Perfetto or chrome://tracing). Every thread appends complete events to its
+// own buffer without locks; stop() collects the buffers once recording has
+// ended. While tracing is off a Scope costs one relaxed atomic load.
+// Names and categories must be string literals: only the pointers are kept.
+namespace trace {
+
+struct SessionStats {
+    long long events = 0;
+    long long dropped = 0;      // Lost to full buffers
+    int threads = 0;            // Threads that recorded at least one event
+    bool written = false;
+};
+
+void start();
+// Ends the session and writes it to path; an empty session or path writes
+// nothing
+SessionStats stop(const std::string& path);
+inline bool isEnabled();
+
+// Label for the calling thread's track; index >= 0 is appended ("worker 3")
+void setThreadName(const char* name, int index = -1);
+
+// Innermost open scope on the calling thread, nullptr when none is open or
+// tracing is off. ThreadPool names its workers' events after it.
+const char* currentScope();
+
+namespace detail {
+extern std::atomic<bool> enabled;
+}
+
+inline bool isEnabled() {
+    return detail::enabled.load(std::memory_order_relaxed);
+}
+
+// Records [construction, destruction) as one event on the calling thread
+class Scope {
+public:
+    Scope(const char* name, const char* category, int index = -1) {
+        if (isEnabled()) begin(name, category, index);
+    }
+    ~Scope() {
+        if (name) end();
+    }
+
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+
+private:
+    const char* name = nullptr;
+    const char* category = nullptr;
+    const char* parent = nullptr;
+    int index = -1;
+    uint32_t generation = 0;    // Session the scope opened in
+    uint64_t startNanos = 0;
+
+    void begin(const char* name, const char* category, int index);
+    void end();
+};
+
+} // namespace trace
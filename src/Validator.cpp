@@ -0,0 +1,196 @@
+#include "Validator.h"
+#include <algorithm>
+#include <cmath>
+
+const char* validationCheckName(ValidationCheck check) {
+    switch (check) {
+        case CHECK_DENSITY:       return "density";
+        case CHECK_FORCE:         return "force";
+        case CHECK_XSPH_VELOCITY: return "xsph velocity";
+        case CHECK_VELOCITY:      return "velocity";
+        default:                  return "unknown";
+    }
+}
+
+double Deviation::relativeMax() const {
+    return maxReference > 0.0 ? maxAbs / maxReference : maxAbs;
+}
+
+double Deviation::relativeRms() const {
+    return sumSqReference > 0.0 ? std::sqrt(sumSq / sumSqReference) : std::sqrt(sumSq);
+}
+
+void Validator::clear() {
+    deviations = {};
+}
+
+reference::Params Validator::makeParams(const Simulation& sim) {
+    reference::Params params;
+    params.smoothingRadius = sim.getSmoothingRadius();
+    params.restDensity = sim.getRestDensity();
+    params.gasConstant = sim.getGasConstant();
+    params.viscosity = sim.getViscosity();
+    params.particleMass = sim.getParticleMass();
+    params.xsphEpsilon = sim.getXSPHEpsilon();
+    params.gravity = { sim.getGravity().x, sim.getGravity().y };
+    if (sim.isAdaptiveSmoothing()) {
+        for (const auto& p : sim.getParticles()) {
+            params.smoothingLengths.push_back(p.smoothingLength);
+        }
+    }
+    if (sim.isAdaptiveResolution()) {
+        for (const auto& p : sim.getParticles()) {
+            params.masses.push_back(p.mass);
+        }
+    }
+    return params;
+}
+
+void Validator::record(ValidationCheck check, double production, double expected) {
+    Deviation& d = deviations[check];
+    double diff = std::abs(production - expected);
+    d.maxAbs = std::max(d.maxAbs, diff);
+    d.sumSq += diff * diff;
+    d.maxReference = std::max(d.maxReference, std::abs(expected));
+    d.sumSqReference += expected * expected;
+    d.samples++;
+}
+
+void Validator::record(ValidationCheck check, const glm::vec2& production,
+                       const reference::Vec2d& expected) {
+    Deviation& d = deviations[check];
+    double dx = production.x - expected.x;
+    double dy = production.y - expected.y;
+    double diff2 = dx * dx + dy * dy;
+    double ref2 = expected.x * expected.x + expected.y * expected.y;
+    d.maxAbs = std::max(d.maxAbs, std::sqrt(diff2));
+    d.sumSq += diff2;
+    d.maxReference = std::max(d.maxReference, std::sqrt(ref2));
+    d.sumSqReference += ref2;
+    d.samples++;
+}
+
+void Validator::checkDensity(const Simulation& sim) {
+    const ParticleArray& particles = sim.getParticles();
+    size_t n = particles.size();
+    reference::computeDensityPressure(makeParams(sim), positions, refDensity, refPressure);
+    density.resize(n);
+    pressure.resize(n);
+    for (size_t i = 0; i < n; i++) {
+        if (checked[i]) record(CHECK_DENSITY, particles[i].density, refDensity[i]);
+        density[i] = particles[i].density;
+        pressure[i] = particles[i].pressure;
+    }
+}
+
+void Validator::checkForces(const Simulation& sim) {
+    const ParticleArray& particles = sim.getParticles();
+    size_t n = particles.size();
+    reference::computeForces(makeParams(sim), positions, velocities, density, pressure, refForces);
+    forces.resize(n);
+    for (size_t i = 0; i < n; i++) {
+        if (checked[i]) record(CHECK_FORCE, particles[i].force, refForces[i]);
+        forces[i] = { particles[i].force.x, particles[i].force.y };
+    }
+}
+
+void Validator::checkXSPH(const Simulation& sim) {
+    const ParticleArray& particles = sim.getParticles();
+    reference::computeXSPHVelocities(makeParams(sim), positions, velocities, density, refVelocities);
+    for (size_t i = 0; i < particles.size(); i++) {
+        if (checked[i]) record(CHECK_XSPH_VELOCITY, particles[i].velocity, refVelocities[i]);
+        velocities[i] = { particles[i].velocity.x, particles[i].velocity.y };
+    }
+    xsphApplied = true;
+}
+
+void Validator::checkVelocity(const Simulation& sim, bool afterBoundary) {
+    const ParticleArray& particles = sim.getParticles();
+    size_t n = particles.size();
+    bool multiRate = sim.isLocalTimeStepping();
+
+    // The multi-rate and wavefront kicks apply XSPH themselves
+    if (sim.isXSPHEnabled() && !xsphApplied) {
+        reference::computeXSPHVelocities(makeParams(sim), positions, velocities, density, refVelocities);
+        velocities = refVelocities;
+    }
+
+    // Past the boundary phase, particles in the wall layer also carry its
+    // penalty impulse; open sides sit at infinity and never exclude anyone
+    glm::vec2 innerMin = sim.getDomainMin() + glm::vec2(Simulation::BOUNDARY_MARGIN);
+    glm::vec2 innerMax = sim.getDomainMax() - glm::vec2(Simulation::BOUNDARY_MARGIN);
+
+    // Semi-implicit Euler kick with the same speed clamp, over each
+    // particle's own bin step
+    double tickDt = static_cast<double>(frameDt / static_cast<float>(sim.getTicksPerFrame()));
+    for (size_t i = 0; i < n; i++) {
+        if (!checked[i]) continue;
+        const glm::vec2& x = particles[i].position;
+        if (afterBoundary && (x.x < innerMin.x || x.y < innerMin.y || x.x > innerMax.x || x.y > innerMax.y)) {
+            continue;
+        }
+
+        double dt = multiRate ? tickDt * static_cast<double>(1 << particles[i].timeBin) : tickDt;
+        reference::Vec2d v = velocities[i];
+        v.x += dt * forces[i].x / density[i];
+        v.y += dt * forces[i].y / density[i];
+        double speed = std::sqrt(v.x * v.x + v.y * v.y);
+        if (speed > 5.0) {
+            v.x = v.x / speed * 5.0;
+            v.y = v.y / speed * 5.0;
+        }
+        record(CHECK_VELOCITY, particles[i].velocity, v);
+    }
+    integrated = true;
+}
+
+void Validator::afterPhase(SimPhase phase, const Simulation& sim) {
+    const ParticleArray& particles = sim.getParticles();
+    size_t n = particles.size();
+
+    switch (phase) {
+        case SimPhase::Neighbors:
+            // State entering the sub-step (after any spatial re-sort)
+            positions.resize(n);
+            velocities.resize(n);
+            for (size_t i = 0; i < n; i++) {
+                positions[i] = { particles[i].position.x, particles[i].position.y };
+                velocities[i] = { particles[i].velocity.x, particles[i].velocity.y };
+            }
+            // A multi-rate tick only steps its active particles; the others
+            // keep their last density, force and velocity
+            checked.assign(n, sim.isLocalTimeStepping() ? 0 : 1);
+            if (sim.isLocalTimeStepping()) {
+                for (int i : sim.getActiveParticles()) checked[i] = 1;
+            }
+            xsphApplied = false;
+            integrated = false;
+            break;
+
+        case SimPhase::Density:
+            checkDensity(sim);
+            break;
+
+        case SimPhase::Forces:
+            checkForces(sim);
+            break;
+
+        case SimPhase::XSPH:
+            checkXSPH(sim);
+            break;
+
+        case SimPhase::Integrate:
+            checkVelocity(sim, false);
+            break;
+
+        case SimPhase::Boundary:
+            // A wavefront sub-step reports only its start and end; density
+            // and force are final by then and no later phase overwrites them
+            if (!integrated) {
+                checkDensity(sim);
+                checkForces(sim);
+                checkVelocity(sim, true);
+            }
+            break;
+    }
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <vector>
+#include "Simulation.h"
+#include "Reference.h"
+
+// Quantities compared against the reference, one per validated phase
+enum ValidationCheck {
+    CHECK_DENSITY = 0,       // After the density/pressure phase
+    CHECK_FORCE,             // After the force phase
+    CHECK_XSPH_VELOCITY,     // After XSPH smoothing (skipped when disabled)
+    CHECK_VELOCITY,          // After integration
+    CHECK_COUNT
+};
+
+const char* validationCheckName(ValidationCheck check);
+
+// Error statistics of one quantity (vector quantities use |difference|)
+struct Deviation {
+    double maxAbs = 0.0;
+    double sumSq = 0.0;
+    double maxReference = 0.0;     // Largest |reference|, the scale for relativeMax
+    double sumSqReference = 0.0;
+    long long samples = 0;
+
+    double relativeMax() const;
+    double relativeRms() const;
+};
+
+// Runs the brute-force double-precision reference (Reference.h) alongside
+// the production phases of every sub-step or multi-rate tick. Each phase is
+// fed the production output of the phase before it, so the deviations
+// measure that phase alone instead of accumulated drift. A wavefront
+// sub-step only reports Neighbors and Boundary, so all of its checks run at
+// the end, leaving out velocities in the wall layer.
+class Validator : public PhaseObserver {
+public:
+    explicit Validator(float frameDt) : frameDt(frameDt) {}
+
+    void afterPhase(SimPhase phase, const Simulation& sim) override;
+
+    const Deviation& getDeviation(ValidationCheck check) const { return deviations[check]; }
+    void clear();
+
+private:
+    float frameDt;
+    std::array<Deviation, CHECK_COUNT> deviations{};
+
+    // Production state captured between phases
+    std::vector<reference::Vec2d> positions;
+    std::vector<reference::Vec2d> velocities;
+    std::vector<reference::Vec2d> forces;
+    std::vector<double> density;
+    std::vector<double> pressure;
+    std::vector<uint8_t> checked;        // Stepped this sub-step or tick
+    bool xsphApplied = false;            // XSPH reported as its own phase
+    bool integrated = false;             // Velocity checked this sub-step
+
+    // Reference results
+    std::vector<double> refDensity;
+    std::vector<double> refPressure;
+    std::vector<reference::Vec2d> refForces;
+    std::vector<reference::Vec2d> refVelocities;
+
+    static reference::Params makeParams(const Simulation& sim);
+    void checkDensity(const Simulation& sim);
+    void checkForces(const Simulation& sim);
+    void checkXSPH(const Simulation& sim);
+    void checkVelocity(const Simulation& sim, bool afterBoundary);
+    void record(ValidationCheck check, double production, double expected);
+    void record(ValidationCheck check, const glm::vec2& production, const reference::Vec2d& expected);
+};
@@ -0,0 +1,69 @@
+#include "VideoWriter.h"
+#include <algorithm>
+#include <iostream>
+
+VideoWriter::VideoWriter() {}
+
+VideoWriter::~VideoWriter() {
+    close();
+}
+
+static bool endsWith(const std::string& s, const std::string& suffix) {
+    return s.size() >= suffix.size() && s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+bool VideoWriter::open(const std::string& path, int w, int h, int fps) {
+    close();
+
+    bool toStdout = path == "-";
+    file = toStdout ? stdout : std::fopen(path.c_str(), "wb");
+    if (!file) {
+        std::cerr << "ERROR::VIDEO: Could not open " << path << std::endl;
+        return false;
+    }
+
+    width = w;
+    height = h;
+    y4m = toStdout || endsWith(path, ".y4m");
+    if (y4m) {
+        std::fprintf(file, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C444\n", width, height, fps);
+        planes.resize(static_cast<size_t>(width) * height * 3);
+    }
+    return true;
+}
+
+void VideoWriter::close() {
+    if (!file) return;
+    if (file == stdout) {
+        std::fflush(file);
+    } else {
+        std::fclose(file);
+    }
+    file = nullptr;
+}
+
+bool VideoWriter::writeFrame(const uint8_t* rgb) {
+    if (!file) return false;
+
+    size_t pixelCount = static_cast<size_t>(width) * height;
+    if (!y4m) {
+        std::fprintf(file, "P6\n%d %d\n255\n", width, height);
+        return std::fwrite(rgb, 3, pixelCount, file) == pixelCount;
+    }
+
+    // BT.601 studio range
+    uint8_t* yPlane = planes.data();
+    uint8_t* uPlane = yPlane + pixelCount;
+    uint8_t* vPlane = uPlane + pixelCount;
+    for (size_t i = 0; i < pixelCount; i++) {
+        int r = rgb[i * 3 + 0];
+        int g = rgb[i * 3 + 1];
+        int b = rgb[i * 3 + 2];
+        yPlane[i] = static_cast<uint8_t>(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+        uPlane[i] = static_cast<uint8_t>(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+        vPlane[i] = static_cast<uint8_t>(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+    }
+
+    std::fputs("FRAME\n", file);
+    return std::fwrite(planes.data(), 1, planes.size(), file) == planes.size();
+}
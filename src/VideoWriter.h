@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// Streams packed 8-bit RGB frames to disk or a pipe, uncompressed.
+// Paths ending in ".y4m" (or "-" for stdout) get a YUV4MPEG2 stream in
+// 4:4:4 BT.601 that ffmpeg/mpv read directly; anything else gets a stream of
+// concatenated binary PPM (P6) images.
+class VideoWriter {
+public:
+    VideoWriter();
+    ~VideoWriter();
+
+    VideoWriter(const VideoWriter&) = delete;
+    VideoWriter& operator=(const VideoWriter&) = delete;
+
+    bool open(const std::string& path, int width, int height, int fps);
+    void close();
+    bool isOpen() const { return file != nullptr; }
+
+    bool writeFrame(const uint8_t* rgb);
+
+private:
+    std::FILE* file = nullptr;
+    bool y4m = false;
+    int width = 0;
+    int height = 0;
+    std::vector<uint8_t> planes;    // Y, U, V for Y4M output
+};
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <glm/glm.hpp>
+#include "Simulation.h"
+
+// Part of the simulation plane shown in a window: the view bounds plus 5%
+// padding, widened along one axis to the window's aspect ratio. Shared by
+// Renderer, SoftwareRenderer and the cursor mapping in main.cpp.
+struct View {
+    glm::vec2 center{0.5f};
+    glm::vec2 halfExtent{0.5f};  // Visible region is center +- halfExtent
+    float pixelsPerUnit = 1.0f;
+};
+
+inline View fitView(const Simulation& sim, int width, int height) {
+    glm::vec2 min, max;
+    sim.getViewBounds(min, max);
+    glm::vec2 size = max - min;
+    float padding = 0.05f * std::max(size.x, size.y);
+    float halfX = 0.5f * size.x + padding;
+    float halfY = 0.5f * size.y + padding;
+    float aspect = static_cast<float>(width) / static_cast<float>(height);
+
+    View view;
+    view.center = glm::vec2(0.5f * (min.x + max.x), 0.5f * (min.y + max.y));
+    if (aspect >= halfX / halfY) {
+        view.halfExtent = glm::vec2(halfY * aspect, halfY);
+        view.pixelsPerUnit = static_cast<float>(height) / (2.0f * halfY);
+    } else {
+        view.halfExtent = glm::vec2(halfX, halfX / aspect);
+        view.pixelsPerUnit = static_cast<float>(width) / (2.0f * halfX);
+    }
+    return view;
+}
+
+// Domain walls as line segments (x0, y0, x1, y1), open sides left out and
+// walls along them clipped to the visible region; returns the count
+inline int domainWalls(const Simulation& sim, const View& view, glm::vec4 walls[4]) {
+    glm::vec2 lo = sim.getDomainMin();
+    glm::vec2 hi = sim.getDomainMax();
+    glm::vec2 visibleLo = view.center - view.halfExtent;
+    glm::vec2 visibleHi = view.center + view.halfExtent;
+    float x0 = std::isfinite(lo.x) ? lo.x : visibleLo.x;
+    float x1 = std::isfinite(hi.x) ? hi.x : visibleHi.x;
+    float y0 = std::isfinite(lo.y) ? lo.y : visibleLo.y;
+    float y1 = std::isfinite(hi.y) ? hi.y : visibleHi.y;
+
+    int count = 0;
+    if (std::isfinite(lo.y)) walls[count++] = glm::vec4(x0, y0, x1, y0);   // Bottom
+    if (std::isfinite(hi.x)) walls[count++] = glm::vec4(x1, y0, x1, y1);   // Right
+    if (std::isfinite(hi.y)) walls[count++] = glm::vec4(x1, y1, x0, y1);   // Top
+    if (std::isfinite(lo.x)) walls[count++] = glm::vec4(x0, y1, x0, y0);   // Left
+    return count;
+}
@@ -0,0 +1,265 @@
+#include "hydration.h"
+#include "Simulation.h"
+#include "DensityField.h"
+#include <cmath>
+#include <memory>
+#include <new>
+
+struct Probe {
+    bool active = false;
+    float x = 0.0f, y = 0.0f;
+    float radius = 0.0f;
+    float strength = 0.0f;
+};
+
+struct hyd_sim {
+    Simulation sim;
+    Probe probes[HYD_MAX_PROBES];
+    std::unique_ptr<DensityField> field;   // Created by the first hyd_update_surface
+
+    explicit hyd_sim(int numParticles) : sim(numParticles) {}
+};
+
+// Entry points that allocate report failure instead of letting an
+// exception (bad_alloc, failed thread start) unwind into the C caller
+template <typename Fn>
+static int guarded(Fn&& fn) {
+    try {
+        fn();
+        return HYD_OK;
+    } catch (...) {
+        return HYD_ERR_FAILED;
+    }
+}
+
+static hyd_array makeArray(const hyd_sim* h, const float* first, int components) {
+    hyd_array array;
+    array.data = h->sim.getParticleCount() > 0 ? first : nullptr;
+    array.stride = sizeof(Particle);
+    array.components = components;
+    array.count = h->sim.getParticleCount();
+    return array;
+}
+
+extern "C" {
+
+int hyd_api_version(void) {
+    return HYD_API_VERSION;
+}
+
+hyd_sim* hyd_create(int num_particles) {
+    if (num_particles <= 0) return nullptr;
+    try {
+        return new hyd_sim(num_particles);
+    } catch (...) {
+        return nullptr;
+    }
+}
+
+void hyd_destroy(hyd_sim* sim) {
+    delete sim;
+}
+
+int hyd_reset(hyd_sim* sim) {
+    return guarded([&] { sim->sim.reset(); });
+}
+
+int hyd_set_threads(hyd_sim* sim, int threads, int numa_aware) {
+    // On failure the previous configuration stays in place
+    return guarded([&] { sim->sim.setExecution(threads, numa_aware != 0); });
+}
+
+void hyd_set_wavefront(hyd_sim* sim, int enabled) {
+    sim->sim.setWavefront(enabled != 0);
+}
+
+int hyd_get_wavefront(const hyd_sim* sim) {
+    return sim->sim.isWavefront() ? 1 : 0;
+}
+
+int hyd_step(hyd_sim* sim, float dt) {
+    return guarded([&] { sim->sim.update(dt); });
+}
+
+int hyd_step_frames(hyd_sim* sim, float dt, int frames) {
+    return guarded([&] {
+        for (int f = 0; f < frames; f++) {
+            for (const Probe& p : sim->probes) {
+                if (p.active) sim->sim.addForce(p.x, p.y, p.radius, p.strength);
+            }
+            sim->sim.update(dt);
+        }
+    });
+}
+
+double hyd_get_sim_time(const hyd_sim* sim) {
+    return sim->sim.getSimTime();
+}
+
+long long hyd_get_frame_index(const hyd_sim* sim) {
+    return sim->sim.getFrameIndex();
+}
+
+void hyd_set_gravity(hyd_sim* sim, float x, float y) {
+    sim->sim.setGravityDirection(x, y);
+}
+
+void hyd_get_gravity(const hyd_sim* sim, float* x, float* y) {
+    glm::vec2 g = sim->sim.getGravity();
+    if (x) *x = g.x;
+    if (y) *y = g.y;
+}
+
+void hyd_set_viscosity(hyd_sim* sim, float viscosity) {
+    sim->sim.setViscosity(viscosity);
+}
+
+float hyd_get_viscosity(const hyd_sim* sim) {
+    return sim->sim.getViscosity();
+}
+
+void hyd_set_gas_constant(hyd_sim* sim, float gas_constant) {
+    sim->sim.setGasConstant(gas_constant);
+}
+
+float hyd_get_gas_constant(const hyd_sim* sim) {
+    return sim->sim.getGasConstant();
+}
+
+int hyd_set_smoothing_radius(hyd_sim* sim, float radius) {
+    if (!(radius > 0.0f) || std::isinf(radius)) return HYD_ERR_INVALID_ARGUMENT;
+    sim->sim.setSmoothingRadius(radius);
+    return HYD_OK;
+}
+
+float hyd_get_smoothing_radius(const hyd_sim* sim) {
+    return sim->sim.getSmoothingRadius();
+}
+
+void hyd_set_adaptive_smoothing(hyd_sim* sim, int enabled) {
+    sim->sim.setAdaptiveSmoothing(enabled != 0);
+}
+
+int hyd_get_adaptive_smoothing(const hyd_sim* sim) {
+    return sim->sim.isAdaptiveSmoothing() ? 1 : 0;
+}
+
+void hyd_set_adaptive_resolution(hyd_sim* sim, int enabled) {
+    sim->sim.setAdaptiveResolution(enabled != 0);
+}
+
+int hyd_get_adaptive_resolution(const hyd_sim* sim) {
+    return sim->sim.isAdaptiveResolution() ? 1 : 0;
+}
+
+int hyd_set_domain(hyd_sim* sim, float min_x, float min_y, float max_x, float max_y) {
+    // Also false for NaN
+    if (!(min_x < max_x) || !(min_y < max_y)) return HYD_ERR_INVALID_ARGUMENT;
+    sim->sim.setDomain(glm::vec2(min_x, min_y), glm::vec2(max_x, max_y));
+    return HYD_OK;
+}
+
+void hyd_get_domain(const hyd_sim* sim, float* min_x, float* min_y, float* max_x, float* max_y) {
+    glm::vec2 min = sim->sim.getDomainMin();
+    glm::vec2 max = sim->sim.getDomainMax();
+    if (min_x) *min_x = min.x;
+    if (min_y) *min_y = min.y;
+    if (max_x) *max_x = max.x;
+    if (max_y) *max_y = max.y;
+}
+
+int hyd_add_force(hyd_sim* sim, float x, float y, float radius, float strength) {
+    return guarded([&] { sim->sim.addForce(x, y, radius, strength); });
+}
+
+int hyd_apply_cursor_force(hyd_sim* sim, float x, float y, int attract) {
+    return guarded([&] { sim->sim.applyCursorForce(x, y, attract != 0); });
+}
+
+int hyd_set_probe(hyd_sim* sim, int index, float x, float y, float radius, float strength) {
+    if (index < 0 || index >= HYD_MAX_PROBES || radius <= 0.0f) return HYD_ERR_INVALID_ARGUMENT;
+    Probe& p = sim->probes[index];
+    p.active = true;
+    p.x = x;
+    p.y = y;
+    p.radius = radius;
+    p.strength = strength;
+    return HYD_OK;
+}
+
+void hyd_clear_probe(hyd_sim* sim, int index) {
+    if (index < 0 || index >= HYD_MAX_PROBES) return;
+    sim->probes[index].active = false;
+}
+
+void hyd_clear_probes(hyd_sim* sim) {
+    for (Probe& p : sim->probes) {
+        p.active = false;
+    }
+}
+
+int hyd_get_particle_count(const hyd_sim* sim) {
+    return sim->sim.getParticleCount();
+}
+
+hyd_array hyd_get_positions(const hyd_sim* sim) {
+    const auto& particles = sim->sim.getParticles();
+    return makeArray(sim, particles.empty() ? nullptr : &particles[0].position.x, 2);
+}
+
+hyd_array hyd_get_velocities(const hyd_sim* sim) {
+    const auto& particles = sim->sim.getParticles();
+    return makeArray(sim, particles.empty() ? nullptr : &particles[0].velocity.x, 2);
+}
+
+hyd_array hyd_get_densities(const hyd_sim* sim) {
+    const auto& particles = sim->sim.getParticles();
+    return makeArray(sim, particles.empty() ? nullptr : &particles[0].density, 1);
+}
+
+hyd_array hyd_get_smoothing_lengths(const hyd_sim* sim) {
+    const auto& particles = sim->sim.getParticles();
+    return makeArray(sim, particles.empty() ? nullptr : &particles[0].smoothingLength, 1);
+}
+
+hyd_array hyd_get_masses(const hyd_sim* sim) {
+    const auto& particles = sim->sim.getParticles();
+    return makeArray(sim, particles.empty() ? nullptr : &particles[0].mass, 1);
+}
+
+int hyd_update_surface(hyd_sim* sim, float cell_scale, float iso_fraction) {
+    try {
+        if (!sim->field) sim->field = std::make_unique<DensityField>(sim->sim.getThreadCount());
+        sim->field->setCellScale(cell_scale);
+        sim->field->setIsoFraction(iso_fraction);
+        sim->field->update(sim->sim);
+        return HYD_OK;
+    } catch (...) {
+        sim->field.reset();
+        return HYD_ERR_FAILED;
+    }
+}
+
+const float* hyd_get_density_grid(const hyd_sim* sim, int* width, int* height,
+                                  float* origin_x, float* origin_y, float* cell_size) {
+    const DensityField* field = sim->field.get();
+    if (width) *width = field ? field->getWidth() : 0;
+    if (height) *height = field ? field->getHeight() : 0;
+    if (origin_x) *origin_x = field ? field->getOrigin().x : 0.0f;
+    if (origin_y) *origin_y = field ? field->getOrigin().y : 0.0f;
+    if (cell_size) *cell_size = field ? field->getCellSize() : 0.0f;
+    return field && !field->getValues().empty() ? field->getValues().data() : nullptr;
+}
+
+hyd_array hyd_get_surface_segments(const hyd_sim* sim) {
+    hyd_array array;
+    const DensityField* field = sim->field.get();
+    int count = field ? static_cast<int>(field->getSegments().size()) : 0;
+    array.data = count > 0 ? &field->getSegments()[0].a.x : nullptr;
+    array.stride = sizeof(SurfaceSegment);
+    array.components = 4;
+    array.count = count;
+    return array;
+}
+
+} // extern "C"
@@ -0,0 +1,131 @@
+/*
+ * libhydration - C interface to the SPH simulation.
+ *
+ * The ABI is stable within a major HYD_API_VERSION: the simulation is an
+ * opaque handle, every entry point takes and returns plain C types, and no
+ * C++ exception crosses the boundary.
+ */
+#ifndef HYDRATION_H
+#define HYDRATION_H
+
+#include <stddef.h>
+
+#if defined(_WIN32)
+#define HYD_API __declspec(dllexport)
+#else
+#define HYD_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define HYD_API_VERSION 1
+#define HYD_MAX_PROBES 16
+
+/* Status codes of the calls that return int and can fail */
+#define HYD_OK 0
+#define HYD_ERR_FAILED (-1)             /* Out of memory or threads */
+#define HYD_ERR_INVALID_ARGUMENT (-2)   /* Nothing was changed */
+
+typedef struct hyd_sim hyd_sim;
+
+/* Strided view of one per-particle field. Element i starts at
+ * (const char*)data + i * stride and holds `components` floats. */
+typedef struct hyd_array {
+    const float* data;
+    size_t stride;
+    int components;
+    int count;
+} hyd_array;
+
+HYD_API int hyd_api_version(void);
+
+/* Calls that can run out of memory or fail to start threads return HYD_OK
+ * on success and HYD_ERR_FAILED on failure; setters that validate their
+ * input return HYD_ERR_INVALID_ARGUMENT for values they reject. The rest
+ * cannot fail. After a failed step the simulation may hold a partially
+ * advanced state, but it stays valid to query, reset or destroy. */
+
+/* Lifecycle. hyd_create returns NULL on failure. */
+HYD_API hyd_sim* hyd_create(int num_particles);
+HYD_API void hyd_destroy(hyd_sim* sim);
+HYD_API int hyd_reset(hyd_sim* sim);
+
+/* Worker threads (0 = all hardware threads); see Simulation::setExecution */
+HYD_API int hyd_set_threads(hyd_sim* sim, int threads, int numa_aware);
+/* Cache-blocked wavefront sub-steps (off by default); results are unchanged
+ * up to particle order. See Simulation::setWavefront */
+HYD_API void hyd_set_wavefront(hyd_sim* sim, int enabled);
+HYD_API int hyd_get_wavefront(const hyd_sim* sim);
+
+/* Stepping. hyd_step_frames advances `frames` frames of length dt in one
+ * call, applying the active probes before each frame. */
+HYD_API int hyd_step(hyd_sim* sim, float dt);
+HYD_API int hyd_step_frames(hyd_sim* sim, float dt, int frames);
+HYD_API double hyd_get_sim_time(const hyd_sim* sim);
+HYD_API long long hyd_get_frame_index(const hyd_sim* sim);
+
+/* Parameters */
+HYD_API void hyd_set_gravity(hyd_sim* sim, float x, float y);
+HYD_API void hyd_get_gravity(const hyd_sim* sim, float* x, float* y);
+HYD_API void hyd_set_viscosity(hyd_sim* sim, float viscosity);
+HYD_API float hyd_get_viscosity(const hyd_sim* sim);
+HYD_API void hyd_set_gas_constant(hyd_sim* sim, float gas_constant);
+HYD_API float hyd_get_gas_constant(const hyd_sim* sim);
+/* The radius must be positive and finite */
+HYD_API int hyd_set_smoothing_radius(hyd_sim* sim, float radius);
+HYD_API float hyd_get_smoothing_radius(const hyd_sim* sim);
+/* Per-particle smoothing lengths that follow local density (off by default) */
+HYD_API void hyd_set_adaptive_smoothing(hyd_sim* sim, int enabled);
+HYD_API int hyd_get_adaptive_smoothing(const hyd_sim* sim);
+/* Merge calm interior particles and split them near surfaces and forces
+ * (off by default; enables adaptive smoothing). The particle count changes
+ * from frame to frame but never exceeds the count given to hyd_create. */
+HYD_API void hyd_set_adaptive_resolution(hyd_sim* sim, int enabled);
+HYD_API int hyd_get_adaptive_resolution(const hyd_sim* sim);
+/* Domain walls (default 0..1 on both axes). An infinite bound (INFINITY /
+ * -INFINITY) leaves that side open; neighbor storage grows with the area
+ * the fluid occupies, not with the domain. Each min must be below its max
+ * and no bound may be NaN. Out pointers may be NULL. */
+HYD_API int hyd_set_domain(hyd_sim* sim, float min_x, float min_y, float max_x, float max_y);
+HYD_API void hyd_get_domain(const hyd_sim* sim, float* min_x, float* min_y, float* max_x, float* max_y);
+
+/* One-shot forces, applied immediately */
+HYD_API int hyd_add_force(hyd_sim* sim, float x, float y, float radius, float strength);
+HYD_API int hyd_apply_cursor_force(hyd_sim* sim, float x, float y, int attract);
+
+/* Persistent probes: radial forces re-applied before every frame stepped by
+ * hyd_step_frames (negative strength attracts). Returns HYD_OK on success. */
+HYD_API int hyd_set_probe(hyd_sim* sim, int index, float x, float y, float radius, float strength);
+HYD_API void hyd_clear_probe(hyd_sim* sim, int index);
+HYD_API void hyd_clear_probes(hyd_sim* sim);
+
+/* Zero-copy access to particle state. The views alias simulation memory and
+ * stay valid until the next call that steps, resets or reconfigures the
+ * simulation (particles may be reordered or moved); re-query afterwards. */
+HYD_API int hyd_get_particle_count(const hyd_sim* sim);
+HYD_API hyd_array hyd_get_positions(const hyd_sim* sim);
+HYD_API hyd_array hyd_get_velocities(const hyd_sim* sim);
+HYD_API hyd_array hyd_get_densities(const hyd_sim* sim);
+HYD_API hyd_array hyd_get_smoothing_lengths(const hyd_sim* sim);
+HYD_API hyd_array hyd_get_masses(const hyd_sim* sim);
+
+/* Free surface: splats particle density onto a grid with node spacing
+ * cell_scale * h and extracts marching-squares contours at iso_fraction *
+ * rest density. Call after stepping; returns HYD_OK on success. The grid and
+ * segment views below stay valid until the next hyd_update_surface. */
+HYD_API int hyd_update_surface(hyd_sim* sim, float cell_scale, float iso_fraction);
+/* Density at grid nodes, row-major from the lowest y: node (i, j) sits at
+ * (origin_x + i * cell_size, origin_y + j * cell_size). NULL before the
+ * first update; any out pointer may be NULL. */
+HYD_API const float* hyd_get_density_grid(const hyd_sim* sim, int* width, int* height,
+                                          float* origin_x, float* origin_y, float* cell_size);
+/* Surface segments, 4 components each: x0, y0, x1, y1 */
+HYD_API hyd_array hyd_get_surface_segments(const hyd_sim* sim);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HYDRATION_H */